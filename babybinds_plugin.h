@@ -0,0 +1,45 @@
+#ifndef BABYBINDS_PLUGIN_ABI_H
+#define BABYBINDS_PLUGIN_ABI_H
+
+/***** Public interface for babybinds plugins *****/
+/* A plugin is a shared object with one or more entry functions. A bind uses it with:
+ *   <keycode>;<...>:@<path to .so> <entry symbol> <argument> <...>
+ * The shared object is loaded once when the config is loaded and the entry is called directly when the bind triggers
+ * (no fork or exec). Entries run on the same thread that reads input events, so they must be quick:
+ * - An entry running longer than the plugin budget (--plugin-budget) is interrupted by a watchdog (a jump out of a signal
+ *   handler) and every bind of its plugin is disabled until babybinds is restarted. Long jobs should be handed to another
+ *   thread or process by the plugin
+ * - The watchdog is a last resort, not a safe recovery: an entry interrupted inside a function that is not
+ *   async-signal-safe (malloc, stdio and most of libc) can leave its locks held or its state broken, and babybinds then
+ *   runs on with them (it may hang or crash later). Entries that can run that long must only call async-signal-safe
+ *   functions, and babybinds should be restarted after a plugin was interrupted
+ * - Entries must not install a SIGALRM handler or use alarm/setitimer, the watchdog needs them
+ * Only this header is needed to build a plugin: cc -shared -fPIC -O2 -o plugin.so plugin.c */
+
+/* For size_t */
+#include <stddef.h>
+
+/* Version of this interface. Increased whenever babybindsPluginCall changes */
+#define BABYBINDS_PLUGIN_ABI 1
+
+/* Everything an entry gets about the trigger */
+struct babybindsPluginCall {
+    /* BABYBINDS_PLUGIN_ABI of the daemon */
+    unsigned long abi;
+    /* Bind number (order in the config, starting at 0) */
+    unsigned long bind;
+    /* Ordered keycodes of the bind */
+    const int* codes;
+    size_t codesSize;
+    /* Kernel timestamp of the input event that triggered the bind (CLOCK_MONOTONIC, or CLOCK_REALTIME if an input device can't switch to it) */
+    long timeSec;
+    long timeUsec;
+    /* Arguments after the entry symbol in the config, with their placeholders filled in (%{keycode}...), null terminated
+       They are only valid during the call */
+    char* const* args;
+};
+
+/* Type of entry functions. A non-zero return value is logged as a warning by the daemon */
+typedef int (*babybindsPluginEntry)(const struct babybindsPluginCall* call);
+
+#endif
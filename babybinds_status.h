@@ -0,0 +1,49 @@
+#ifndef BABYBINDS_STATUS_ABI_H
+#define BABYBINDS_STATUS_ABI_H
+
+/***** Public layout of the babybinds status page *****/
+/* The daemon publishes what it is doing in a shared memory file (/dev/shm/babybinds.<pid> by default, see --status)
+ * Monitors map it read-only and read it without any syscall into the daemon. The page is:
+ *   struct babybindsStatus, followed by bindNum unsigned longs (trigger count of each bind, by bind number)
+ * All fields are native unsigned longs of the host, so readers must be built for the same architecture
+ * Consistency comes from a seqlock: seq is odd while the daemon updates the page. A reader reads seq (waiting while it is
+ * odd), copies the page, and retries if seq changed during the copy, with a memory barrier after the first read of seq and
+ * before the second one (see tools/bbstatus.c). The daemon never waits for readers, and an update is only a short copy
+ * at the end of each event loop wakeup: a page that stays odd for long (retries should be limited) is from a daemon that
+ * was killed in an update (check pid) or hangs
+ * The page is removed when the daemon shuts down. It has mode 0640 (it shows the keys held), so readers need the daemon's
+ * user or group. Only this header is needed to build a reader */
+
+/* Identification of the page ("bbst") and version of this layout. Increased whenever the layout changes */
+#define BABYBINDS_STATUS_MAGIC 0x62627374UL
+#define BABYBINDS_STATUS_VERSION 1
+
+/* Number of trigger latency buckets. Bucket n counts latencies of [2^n, 2^(n+1)) microseconds (bucket 0 also gets 0) */
+#define BABYBINDS_STATUS_LATENCY_BUCKETS 32
+
+/* Size of the pressed key bit array (one bit per keycode, KEY_CNT bits) */
+#define BABYBINDS_STATUS_KEY_BYTES 96
+
+struct babybindsStatus {
+    /* BABYBINDS_STATUS_MAGIC and BABYBINDS_STATUS_VERSION */
+    unsigned long magic;
+    unsigned long version;
+    /* Seqlock sequence number, odd while the page is being updated */
+    unsigned long seq;
+    /* Process id of the daemon */
+    unsigned long pid;
+    /* Input events read, key events, key events dropped by the debounce filter and binds triggered */
+    unsigned long events;
+    unsigned long keyEvents;
+    unsigned long debounced;
+    unsigned long triggers;
+    /* Number of binds (and of trigger counts after this struct) */
+    unsigned long bindNum;
+    /* Time from the kernel timestamp of the event that triggered a bind to the bind being triggered
+       Deferred binds include the time they waited for a longer combo */
+    unsigned long latency[BABYBINDS_STATUS_LATENCY_BUCKETS];
+    /* Keys held on any input device right now (bit n % 8 of byte n / 8 is keycode n) */
+    unsigned char pressed[BABYBINDS_STATUS_KEY_BYTES];
+};
+
+#endif
@@ -1,78 +1,180 @@
 /***** call.h implementation *****/
+/* Needed for CLOCK_MONOTONIC */
+#define _GNU_SOURCE
+
 #include "call.h"
 
+/* Overlap window and its timer (and the timer's read buffer, which gets the expiration count) */
+static long deferWindow = 0;
+static int deferTimerFD = -1;
+static unsigned char deferTimerBuf[8];
+
+/*** Internal functions ***/
+/* Arms the deferred bind timer for the earliest deadline of the views, or disarms it if no view has a deferred bind
+   Returns 1 on success, 0 on failure */
+static int deferArm(void);
+
+/*** Implementations ***/
+static int deferArm(void) {
+    struct itimerspec expiration;
+    const struct timeval* earliest = NULL;
+    size_t n;
+
+    for(n = 0; n < deviceViewCount(); ++n) {
+        const struct keyView* view = deviceGetView(n);
+
+        if(view->deferredBind < 0)
+            continue;
+        if(earliest == NULL || view->deferredBindDeadline.tv_sec < earliest->tv_sec
+            || (view->deferredBindDeadline.tv_sec == earliest->tv_sec && view->deferredBindDeadline.tv_usec < earliest->tv_usec))
+            earliest = &view->deferredBindDeadline;
+    }
+
+    /* A zero expiration disarms the timer */
+    memset(&expiration, 0, sizeof(expiration));
+    if(earliest != NULL) {
+        expiration.it_value.tv_sec = earliest->tv_sec;
+        expiration.it_value.tv_nsec = (long)earliest->tv_usec * 1000;
+    }
+
+    return timerfd_settime(deferTimerFD, TFD_TIMER_ABSTIME, &expiration, NULL) == 0;
+}
+
 void shutdownDaemon(void) {
     size_t n;
+
+    /* Shutting down frees memory */
+    sallocUnlock();
     
-    /* Check if the input device was valid and close it if it was */
-    if(devFD > -1)
-        close(devFD);
+    /* Close the input devices */
+    deviceShutdown();
+
+    if(deferTimerFD > -1)
+        close(deferTimerFD);
+    deferTimerFD = -1;
+
+    /* Remove the status page */
+    statusShutdown();
+
+    /* Disconnect executors or from the reader (before the binds are freed) */
+    serveShutdown();
+
+    /* Unload the compiled matcher and plugins */
+    matcherShutdown();
+    pluginShutdown();
+
+    /* Destroy the passthrough device (the input device was ungrabbed when it was closed) */
+    passthroughShutdown();
+
+    /* Stop capturing output and free the event loop (after the input device and pipes, which it doesn't close) */
+    captureShutdown();
+    loopShutdown();
     
+    /* Dropped binds (see dropScope) are already freed */
     for(n = 0; n < bindNum; ++n) {
-        if(comboBinds != NULL)
+        if(comboBinds != NULL && comboBinds[n].codes != NULL)
             sfree(comboBinds[n].codes);
-        if(comboExecs != NULL) {
+        if(comboExecs != NULL && comboExecs[n].data != NULL) {
+            templateFree(&comboExecs[n]);
             sfree(comboExecs[n].elems);
             sfree(comboExecs[n].data);
         }
     }
-    sfree(comboBinds);
-    sfree(comboExecs);
+    /* There are no binds in probe mode */
+    if(comboBinds != NULL)
+        sfree(comboBinds);
+    if(comboExecs != NULL)
+        sfree(comboExecs);
+
+    for(n = 0; n < scopeNum; ++n)
+        sfree(scopeNames[n]);
+    if(scopeNames != NULL)
+        sfree(scopeNames);
 }
 
 void interruptHandler(int signum) {
-    if(signum == SIGINT) {
-        taggedMsg(TM_info | TM_flush | TM_newline, "Interrupt caught! Shutting down gracefully...");
+    if(signum == SIGINT || signum == SIGTERM || signum == SIGHUP) {
+        if(signum == SIGINT)
+            taggedMsg(TM_info | TM_flush | TM_newline, "Interrupt caught! Shutting down gracefully...");
+        else
+            taggedMsg(TM_info | TM_flush | TM_newline, signum == SIGTERM ? "Termination signal caught! Shutting down gracefully..."
+                                                                         : "Hangup caught! Shutting down gracefully...");
+        probeReport();
+        printStats(&stats);
         shutdownDaemon();
         exit(EXIT_SUCCESS);
     }
 }
 
-void doShellExec(char** command) {
+void doShellExec(char** command, size_t bind) {
+    /* Prepare output capturing */
+    const int captureSlot = captureSetup(bind);
+
     /* Fork */
     pid_t pid = fork();
     if(pid == 0) {
-        /* In the child process: Execute shell program */
+        /* In the child process: Allocations don't matter here anymore (and exec might need them) */
+        sallocUnlock();
+
+        /* Drop the real-time scheduling and CPU pinning inherited from the daemon */
+        lowLatencyChildReset();
+
+        /* Redirect output */
+        captureChild(captureSlot);
+
+        /* Execute shell program */
         if(execvp(command[0], command) == -1)
             taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not exec command: ", strerror(errno));
         /* This won't normally be executed, only if an error occurred
-           If an error indeed occurred, do the regular cleanup */
-        shutdownDaemon();
-        exit(EXIT_FAILURE);
+           The child shares the daemon's devices, sockets and shared memory, so it must not shut them down: just leave
+           (_exit, so the stdio buffers inherited from the daemon aren't written twice either) */
+        _exit(EXIT_FAILURE);
     }
     else if(pid == -1){
         /* In the parent process, but child could not be created! :(
            Print error message and DO NOT abort, just ignore */
         taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not create child process, ignoring: ", strerror(errno));
+        captureAbort(captureSlot);
+    }
+    else {
+        /* In the parent process: Start reading the child's output */
+        captureParent(captureSlot, pid);
     }
-    /* Note that nothing happens if in the parent process and the child was successfully created, it just returns */
 }
 
-void doSingleBind(int keycode) {
-    /* Iterate over all keybinds */
+long findSingleBind(size_t scope, int keycode) {
     size_t i;
-    for(i = 0; i < bindNum; ++i) {
-        /* Single sized and same keycode? */
-        if(comboBinds[i].size == 1 && comboBinds[i].codes[0] == keycode) {
-            /* Trigger keybind! */
-            fputs("Single bind triggered: ", stdout);
-            printCommand(comboExecs[i].elems, comboExecs[i].size);
-            putchar('\n');
-            fflush(stdout);
-            doShellExec(comboExecs[i].elems);
-            /* All done! Return... */
-            return;
-        }
+
+    if(keycode < 0 || keycode >= KEY_CNT)
+        return -1;
+
+    /* Most keys have no single-key bind in any scope: that takes a single load */
+    i = singleBindIndex[keycode];
+    if(i == 0)
+        return -1;
+
+    if(matcherLoaded())
+        return matcherFindSingle(scope, keycode);
+
+    /* Walk the binds of the keycode (usually just one) */
+    for(; i > 0; i = comboBinds[i - 1].nextSingle) {
+        if(comboBinds[i - 1].scope == scope)
+            return (long)(i - 1);
     }
+
+    return -1;
 }
 
-void doBind(int* comboBuffer, size_t comboBufferN) {
+long findComboBind(size_t scope, int* comboBuffer, size_t comboBufferN) {
     size_t i;
-    
+
+    if(matcherLoaded())
+        return matcherFindCombo(scope, comboBuffer, comboBufferN);
+
     /* Iterate over all keybinds */
     for(i = 0; i < bindNum; ++i) {
-        /* Same size? */
-        if(comboBinds[i].size == comboBufferN) {
+        /* Same size and scope? */
+        if(comboBinds[i].size == comboBufferN && comboBinds[i].scope == scope) {
             size_t n;
             
             /* Same keycodes? */
@@ -80,19 +182,131 @@ void doBind(int* comboBuffer, size_t comboBufferN) {
                 if(comboBinds[i].codes[n] != comboBuffer[n])
                     break; /* Different keycode! Stop looping... */
             }
-            /* If the loop didnt reach the end, then the keycodes didnt match. Skip this combo */
-            if(n != comboBufferN)
-                continue;
-
-            /* Yes! Trigger keybind! */
-            fputs("Multi-key bind triggered: ", stdout);
-            printCommand(comboExecs[i].elems, comboExecs[i].size);
-            putchar('\n');
-            fflush(stdout);
-            doShellExec(comboExecs[i].elems);
-            /* All done! Return... */
-            return;
+            /* If the loop reached the end, then all keycodes matched */
+            if(n == comboBufferN)
+                return (long)i;
+        }
+    }
+
+    return -1;
+}
+
+void triggerBind(size_t bind, const char* message, const struct input_event* ev, const char* device) {
+    char** command;
+
+    ++stats.triggers;
+    statusTrigger(bind, &ev->time);
+    fputs(message, stdout);
+
+    /* The command of an executor's bind is in the executor */
+    if(serveIsBind(bind)) {
+        serveTrigger(bind, ev, device);
+        return;
+    }
+
+    /* Templated commands are expanded from the bind tables (the compiled matcher only has their unexpanded argv) */
+    command = templateExpand(&comboExecs[bind], ev, device);
+    printCommand(command, comboExecs[bind].size);
+    putchar('\n');
+    fflush(stdout);
+    if(pluginIsBind(bind))
+        pluginCall(bind, command, &ev->time);
+    else
+        doShellExec((matcherLoaded() && comboExecs[bind].tmpl == NULL) ? matcherExec(bind) : command, bind);
+}
+
+void doSingleBind(size_t scope, const struct input_event* ev, size_t device) {
+    const long bind = findSingleBind(scope, ev->code);
+
+    if(bind >= 0)
+        triggerBind((size_t)bind, "Single bind triggered: ", ev, deviceName(device));
+}
+
+int keyHasSingleBind(size_t scope, int keycode) {
+    return findSingleBind(scope, keycode) >= 0;
+}
+
+int keyInCombo(int keycode) {
+    return keycode >= 0 && keycode < KEY_CNT && ((comboKeyMap[keycode / 8] >> (keycode % 8)) & 1);
+}
+
+int doBind(struct keyView* view, const struct input_event* ev, size_t device) {
+    const long bind = findComboBind((size_t)view->scope, view->comboBuffer, view->comboBufferN);
+
+    if(bind < 0)
+        return 0;
+
+    /* A longer combo can still be reached from here, so wait a bit for it before triggering */
+    if(comboBinds[bind].hasSuperset && deferWindow > 0) {
+        struct timespec now;
+
+        if(clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+            view->deferredBindDeadline.tv_sec = now.tv_sec + deferWindow / 1000;
+            view->deferredBindDeadline.tv_usec = now.tv_nsec / 1000 + (deferWindow % 1000) * 1000;
+            if(view->deferredBindDeadline.tv_usec >= 1000000) {
+                ++view->deferredBindDeadline.tv_sec;
+                view->deferredBindDeadline.tv_usec -= 1000000;
+            }
+
+            view->deferredBind = bind;
+            view->deferredBindEvent = *ev;
+            view->deferredBindDevice = device;
+            if(deferArm())
+                return 1;
+            view->deferredBind = -1;
         }
+        /* Couldn't arm the timer! Better trigger now than never */
+    }
+
+    /* Yes! Trigger keybind! This one is longer than the deferred one (if any), so it wins */
+    view->deferredBind = -1;
+    triggerBind((size_t)bind, "Multi-key bind triggered: ", ev, deviceName(device));
+    return 1;
+}
+
+int deferInit(long windowMs) {
+    deferWindow = windowMs;
+    if(windowMs <= 0)
+        return 1;
+
+    deferTimerFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(deferTimerFD < 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not create overlap window timer: ", strerror(errno));
+        return 0;
     }
+
+    return loopAdd(deferTimerFD, LK_timer, 0, deferTimerBuf, sizeof(deferTimerBuf));
 }
 
+void doDeferredBind(struct keyView* view) {
+    const long bind = view->deferredBind;
+
+    if(bind < 0)
+        return;
+
+    /* The timer is not disarmed. If it expires for this deadline, there is simply nothing to trigger and it is re-armed */
+    view->deferredBind = -1;
+    triggerBind((size_t)bind, "Multi-key bind triggered (deferred): ", &view->deferredBindEvent, deviceName(view->deferredBindDevice));
+}
+
+void doExpiredDeferredBinds(void) {
+    struct timespec now;
+    size_t n;
+
+    if(clock_gettime(CLOCK_MONOTONIC, &now) < 0) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not read the clock for deferred binds: ", strerror(errno));
+        return;
+    }
+
+    for(n = 0; n < deviceViewCount(); ++n) {
+        struct keyView* view = deviceGetView(n);
+
+        if(view->deferredBind >= 0 && (view->deferredBindDeadline.tv_sec < now.tv_sec
+            || (view->deferredBindDeadline.tv_sec == now.tv_sec && view->deferredBindDeadline.tv_usec <= now.tv_nsec / 1000)))
+            doDeferredBind(view);
+    }
+
+    /* If it can't be re-armed, the remaining deferred binds still trigger on the next key release */
+    if(!deferArm())
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not arm the overlap window timer: ", strerror(errno));
+}
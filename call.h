@@ -11,6 +11,39 @@
 /* For error messages */
 #include "printmsgs.h"
 
+/* For shutting down the event loop */
+#include "eventloop.h"
+
+/* For capturing the output of children */
+#include "capture.h"
+
+/* For the compiled matcher */
+#include "compile.h"
+
+/* For plugin binds */
+#include "plugin.h"
+
+/* For destroying the passthrough device */
+#include "passthrough.h"
+
+/* For resetting the low-latency mode in children */
+#include "realtime.h"
+
+/* For closing input devices and their key views */
+#include "device.h"
+
+/* For the status page */
+#include "status.h"
+
+/* For filling in argument templates */
+#include "template.h"
+
+/* For the probe mode report */
+#include "probe.h"
+
+/* For binds of executors (in a reader) */
+#include "serve.h"
+
 /* For errno */
 #include <errno.h>
 #include <string.h>
@@ -22,19 +55,55 @@
 /* For signal handling */
 #include <signal.h>
 
+/* For the deferred bind timer */
+#include <sys/timerfd.h>
+
 /* Gracefully shuts down (closes all I/O and frees memory) */
 void shutdownDaemon(void);
 
-/* Catches SIGINT to shut down */
+/* Catches SIGINT, SIGTERM and SIGHUP to shut down */
 void interruptHandler(int signum);
 
-/* Executes a shell command in a non-blocking way */
-void doShellExec(char** command);
+/* Executes a shell command of a bind in a non-blocking way. Its output is captured or discarded (see capture.h) */
+void doShellExec(char** command, size_t bind);
+
+/* Finds the single-key bind of a key in a scope. Returns the bind number, or -1 if there is none
+   Uses the keycode index, and the compiled matcher if loaded for keys that have single-key binds */
+long findSingleBind(size_t scope, int keycode);
+
+/* Finds the bind of an ordered key combination in a scope. Returns the bind number, or -1 if there is none
+   Uses the compiled matcher if loaded, else looks through all binds */
+long findComboBind(size_t scope, int* comboBuffer, size_t comboBufferN);
+
+/* Fills in the argument template of a bind with the event that triggered it and the name of the device it came from, prints
+   a message with the command and executes it (or calls its plugin, with the time of the event)
+   In a reader, binds of executors are sent to their executor instead */
+void triggerBind(size_t bind, const char* message, const struct input_event* ev, const char* device);
+
+/* Like doBind but for a single key (the key of the release event) */
+void doSingleBind(size_t scope, const struct input_event* ev, size_t device);
+
+/* Returns 1 if there is a single-key bind for this key in a scope, 0 if not */
+int keyHasSingleBind(size_t scope, int keycode);
+
+/* Returns 1 if the key is in any combo of two or more keys (of any scope), 0 if not. Without it, no combo can match */
+int keyInCombo(int keycode);
+
+/* Checks if there is any keybind in the view's scope with the view's key combination and do what the bind wants - NON-BLOCKING
+   If the bind is ambiguous (a longer bind contains its keys), it is deferred instead: it triggers when a key of the view is
+   released or when the overlap window expires, unless a longer bind is matched first (longest match wins)
+   Every view has its own deferred bind and deadline. The views share the timer, which is armed for the earliest deadline
+   Returns 1 if a bind matched (triggered or deferred), 0 if not */
+int doBind(struct keyView* view, const struct input_event* ev, size_t device);
+
+/* Sets up the timer for deferred binds and adds it to the event loop. A window of 0 disables deferring
+   Returns 1 on success, 0 on failure */
+int deferInit(long windowMs);
 
-/* Like doBind but for a single key */
-void doSingleBind(int keycode);
+/* Triggers the deferred bind of a view, if there is one (on key releases of the view) */
+void doDeferredBind(struct keyView* view);
 
-/* Checks if there is any keybind with this key combination and do what the bind wants - NON-BLOCKING */
-void doBind(int* comboBuffer, size_t comboBufferN);
+/* Triggers the deferred binds whose overlap window has ended, and arms the timer for the next deadline (on LK_timer completions) */
+void doExpiredDeferredBinds(void);
 
 #endif
@@ -0,0 +1,403 @@
+/***** capture.h implementation *****/
+/* Needed for pipe2 and O_CLOEXEC */
+#define _GNU_SOURCE
+
+#include "capture.h"
+
+/* For errno */
+#include <errno.h>
+#include <string.h>
+
+/* For pipes, files and renaming */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Names of the captured streams, used in the log tags */
+static const char* const captureStreamNames[2] = { "stdout", "stderr" };
+
+/* Room kept at the end of the output buffer for the note about dropped lines */
+#define CAPTURE_NOTE_ROOM 64
+
+/* A captured child */
+struct captureSlot {
+    /* Child pid (0 if not yet known) and the bind that spawned it */
+    pid_t pid;
+    size_t bind;
+    /* 1 if the slot is in use */
+    int used;
+    /* Read (parent) and write (child) ends of the stdout and stderr pipes, -1 if closed */
+    int readFDs[2];
+    int writeFDs[2];
+    /* Event loop read buffers */
+    char readBufs[2][BABYBINDS_CAPTURE_READ];
+    /* Partial lines waiting for a newline */
+    char lineBufs[2][BABYBINDS_CAPTURE_LINE];
+    size_t lineBufsN[2];
+};
+
+static struct captureSlot captureSlots[BABYBINDS_CAPTURE_SLOTS];
+
+/* Log file descriptor, its current size and paths (current and rotated) */
+static int captureLogFD = -1;
+static unsigned long captureLogSize = 0;
+static char* captureLogPath = NULL;
+static char* captureLogOldPath = NULL;
+
+/* /dev/null, where discarded output goes */
+static int captureNullFD = -1;
+
+/* 1 if all output is discarded */
+static int captureDiscard = 0;
+
+/* Tagged lines of this wakeup, written to the log at once by captureFlush, and lines dropped as it was full */
+static char captureOut[BABYBINDS_CAPTURE_FLUSH];
+static size_t captureOutN = 0;
+static unsigned long captureDropped = 0;
+
+/*** Internal functions ***/
+/* Opens the log file for appending and gets its size. Returns 1 on success, 0 on failure */
+static int captureOpenLog(void);
+
+/* Adds a line with its tag to the output buffer (see captureFlush), or drops it if the buffer is full */
+static void captureQueueLine(struct captureSlot* slot, int stream, const char* line, size_t lineN);
+
+/* Closes one of the read pipes of a slot, freeing the slot if both are closed */
+static void captureClose(struct captureSlot* slot, int stream);
+
+/* Writes an unsigned number as decimal to dst. Returns the number of characters written (at most 20) */
+static size_t captureFormatNumber(char* dst, unsigned long n);
+
+/*** Implementations ***/
+static int captureOpenLog(void) {
+    struct stat logStat;
+
+    captureLogFD = open(captureLogPath, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if(captureLogFD < 0) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not open command output log: ", strerror(errno));
+        return 0;
+    }
+
+    if(fstat(captureLogFD, &logStat) == 0)
+        captureLogSize = (unsigned long)logStat.st_size;
+    else
+        captureLogSize = 0;
+
+    return 1;
+}
+
+static size_t captureFormatNumber(char* dst, unsigned long n) {
+    char digits[20];
+    size_t digitsN = 0;
+    size_t i;
+
+    /* Get digits in reverse order */
+    do {
+        digits[digitsN++] = (char)('0' + n % 10);
+        n /= 10;
+    } while(n > 0);
+
+    for(i = 0; i < digitsN; ++i)
+        dst[i] = digits[digitsN - i - 1];
+
+    return digitsN;
+}
+
+static void captureQueueLine(struct captureSlot* slot, int stream, const char* line, size_t lineN) {
+    /* Tag ("[bind <n> pid <n> <stream>] ", at most 64 characters) + line + newline */
+    char* const out = captureOut + captureOutN;
+    size_t outN;
+
+    if(captureLogFD < 0)
+        return;
+
+    if(captureOutN + 64 + lineN + 1 > BABYBINDS_CAPTURE_FLUSH - CAPTURE_NOTE_ROOM) {
+        ++captureDropped;
+        return;
+    }
+
+    outN = 0;
+    memcpy(out, "[bind ", 6);
+    outN += 6;
+    outN += captureFormatNumber(out + outN, (unsigned long)slot->bind);
+    memcpy(out + outN, " pid ", 5);
+    outN += 5;
+    outN += captureFormatNumber(out + outN, (unsigned long)slot->pid);
+    out[outN++] = ' ';
+    memcpy(out + outN, captureStreamNames[stream], 6);
+    outN += 6;
+    out[outN++] = ']';
+    out[outN++] = ' ';
+    memcpy(out + outN, line, lineN);
+    outN += lineN;
+    out[outN++] = '\n';
+
+    captureOutN += outN;
+}
+
+static void captureClose(struct captureSlot* slot, int stream) {
+    /* Log whatever is left in the line buffer */
+    if(slot->lineBufsN[stream] > 0) {
+        captureQueueLine(slot, stream, slot->lineBufs[stream], slot->lineBufsN[stream]);
+        slot->lineBufsN[stream] = 0;
+    }
+
+    if(slot->readFDs[stream] > -1) {
+        loopRemove(slot->readFDs[stream]);
+        close(slot->readFDs[stream]);
+        slot->readFDs[stream] = -1;
+    }
+
+    if(slot->readFDs[0] < 0 && slot->readFDs[1] < 0)
+        slot->used = 0;
+}
+
+int captureInit(const char* logPath, int discard) {
+    size_t n;
+
+    for(n = 0; n < BABYBINDS_CAPTURE_SLOTS; ++n) {
+        captureSlots[n].used = 0;
+        captureSlots[n].readFDs[0] = captureSlots[n].readFDs[1] = -1;
+        captureSlots[n].writeFDs[0] = captureSlots[n].writeFDs[1] = -1;
+    }
+
+    /* /dev/null is always needed, as it is also the fallback when no capture slots are left */
+    captureNullFD = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if(captureNullFD < 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not open /dev/null: ", strerror(errno));
+        return 0;
+    }
+
+    captureDiscard = discard;
+    if(discard)
+        return 1;
+
+    /* Get log path (~/.babybinds.log by default) and rotated log path (log path + .1) */
+    if(logPath == NULL) {
+        const char* homePath = getenv("HOME");
+
+        if(homePath == NULL) {
+            taggedMsg(TM_error | TM_flush | TM_newline, "Could not get home path for the command output log!");
+            return 0;
+        }
+
+        /* Size of home path + size of /.babybinds.log (16) + null-terminator size (1) */
+        captureLogPath = salloc(NULL, strlen(homePath) + 17);
+        if(salloc_f())
+            return 0;
+
+        strcpy(captureLogPath, homePath);
+        strcat(captureLogPath, "/.babybinds.log");
+    }
+    else {
+        captureLogPath = salloc(NULL, strlen(logPath) + 1);
+        if(salloc_f())
+            return 0;
+
+        strcpy(captureLogPath, logPath);
+    }
+
+    captureLogOldPath = salloc(NULL, strlen(captureLogPath) + 3);
+    if(salloc_f())
+        return 0;
+
+    strcpy(captureLogOldPath, captureLogPath);
+    strcat(captureLogOldPath, ".1");
+
+    return captureOpenLog();
+}
+
+int captureSetup(size_t bind) {
+    struct captureSlot* slot;
+    int pipeFDs[2];
+    int stream;
+    size_t n;
+
+    if(captureDiscard)
+        return -1;
+
+    for(n = 0; n < BABYBINDS_CAPTURE_SLOTS; ++n) {
+        if(!captureSlots[n].used)
+            break;
+    }
+
+    if(n == BABYBINDS_CAPTURE_SLOTS) {
+        taggedMsg(TM_warning | TM_flush | TM_newline, "Too many commands with captured output running, discarding output...");
+        return -1;
+    }
+
+    slot = &captureSlots[n];
+    for(stream = 0; stream < 2; ++stream) {
+        /* Close-on-exec on both ends, dup2 in the child clears it for stdout and stderr */
+        if(pipe2(pipeFDs, O_CLOEXEC) == -1) {
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not create output pipe, discarding output: ", strerror(errno));
+            if(stream == 1) {
+                close(slot->readFDs[0]);
+                close(slot->writeFDs[0]);
+                slot->readFDs[0] = slot->writeFDs[0] = -1;
+            }
+            return -1;
+        }
+
+        slot->readFDs[stream] = pipeFDs[0];
+        slot->writeFDs[stream] = pipeFDs[1];
+        slot->lineBufsN[stream] = 0;
+    }
+
+    slot->used = 1;
+    slot->pid = 0;
+    slot->bind = bind;
+
+    return (int)n;
+}
+
+void captureChild(int slot) {
+    size_t n;
+
+    if(slot < 0) {
+        /* If /dev/null could not be opened there is no choice but to inherit the daemon's streams */
+        if(captureNullFD > -1) {
+            dup2(captureNullFD, STDOUT_FILENO);
+            dup2(captureNullFD, STDERR_FILENO);
+        }
+    }
+    else {
+        dup2(captureSlots[slot].writeFDs[0], STDOUT_FILENO);
+        dup2(captureSlots[slot].writeFDs[1], STDERR_FILENO);
+    }
+
+    /* The captures belong to the parent. Forget about them so a failed exec doesn't log partial lines again when cleaning up */
+    for(n = 0; n < BABYBINDS_CAPTURE_SLOTS; ++n)
+        captureSlots[n].used = 0;
+
+    /* The rest of the file descriptors are close-on-exec */
+}
+
+void captureParent(int slot, pid_t pid) {
+    struct captureSlot* captured;
+    int stream;
+
+    if(slot < 0)
+        return;
+
+    captured = &captureSlots[slot];
+    captured->pid = pid;
+
+    for(stream = 0; stream < 2; ++stream) {
+        /* The child has its own copy of the write end. Closing ours makes the read end get an EOF when the child exits */
+        close(captured->writeFDs[stream]);
+        captured->writeFDs[stream] = -1;
+
+        fcntl(captured->readFDs[stream], F_SETFL, fcntl(captured->readFDs[stream], F_GETFL) | O_NONBLOCK);
+        if(!loopAdd(captured->readFDs[stream], LK_capture, (size_t)slot * 2 + stream, captured->readBufs[stream], BABYBINDS_CAPTURE_READ)) {
+            /* Can't watch it, so close it. The child gets a SIGPIPE/EPIPE if it writes to it, which is better than blocking forever */
+            close(captured->readFDs[stream]);
+            captured->readFDs[stream] = -1;
+        }
+    }
+
+    if(captured->readFDs[0] < 0 && captured->readFDs[1] < 0)
+        captured->used = 0;
+}
+
+void captureAbort(int slot) {
+    int stream;
+
+    if(slot < 0)
+        return;
+
+    for(stream = 0; stream < 2; ++stream) {
+        close(captureSlots[slot].readFDs[stream]);
+        close(captureSlots[slot].writeFDs[stream]);
+        captureSlots[slot].readFDs[stream] = captureSlots[slot].writeFDs[stream] = -1;
+    }
+
+    captureSlots[slot].used = 0;
+}
+
+void captureHandle(const struct loopCompletion* completion) {
+    struct captureSlot* slot = &captureSlots[completion->index / 2];
+    const int stream = (int)(completion->index % 2);
+    const char* data = completion->buf;
+    long n;
+
+    /* End of file (child exited or closed the stream) or error: stop capturing this stream */
+    if(completion->result <= 0) {
+        captureClose(slot, stream);
+        return;
+    }
+
+    /* Split into lines. Lines longer than BABYBINDS_CAPTURE_LINE are split too */
+    for(n = 0; n < completion->result; ++n) {
+        if(data[n] == '\n' || slot->lineBufsN[stream] == BABYBINDS_CAPTURE_LINE) {
+            captureQueueLine(slot, stream, slot->lineBufs[stream], slot->lineBufsN[stream]);
+            slot->lineBufsN[stream] = 0;
+            if(data[n] == '\n')
+                continue;
+        }
+
+        slot->lineBufs[stream][slot->lineBufsN[stream]++] = data[n];
+    }
+}
+
+void captureFlush(void) {
+    static const char note[] = "[babybinds] Too much command output at once, lines dropped: ";
+
+    if(captureOutN == 0 && captureDropped == 0)
+        return;
+
+    if(captureLogFD < 0) {
+        captureOutN = 0;
+        captureDropped = 0;
+        return;
+    }
+
+    /* There is always room for the note (see CAPTURE_NOTE_ROOM) */
+    if(captureDropped > 0) {
+        memcpy(captureOut + captureOutN, note, sizeof(note) - 1);
+        captureOutN += sizeof(note) - 1;
+        captureOutN += captureFormatNumber(captureOut + captureOutN, captureDropped);
+        captureOut[captureOutN++] = '\n';
+        captureDropped = 0;
+    }
+
+    /* Rotate log if needed. If reopening fails, output is lost until the daemon is restarted */
+    if(captureLogSize + captureOutN > BABYBINDS_CAPTURE_LOG_SIZE) {
+        close(captureLogFD);
+        captureLogFD = -1;
+        if(rename(captureLogPath, captureLogOldPath) == -1)
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not rotate command output log: ", strerror(errno));
+        if(!captureOpenLog()) {
+            captureOutN = 0;
+            return;
+        }
+    }
+
+    /* A failed or short write just loses (part of) the output. Waiting for the disk is not an option */
+    if(write(captureLogFD, captureOut, captureOutN) > 0)
+        captureLogSize += captureOutN;
+    captureOutN = 0;
+}
+
+void captureShutdown(void) {
+    size_t n;
+
+    for(n = 0; n < BABYBINDS_CAPTURE_SLOTS; ++n) {
+        if(captureSlots[n].used) {
+            captureClose(&captureSlots[n], 0);
+            captureClose(&captureSlots[n], 1);
+        }
+    }
+    captureFlush();
+
+    if(captureLogFD > -1)
+        close(captureLogFD);
+    if(captureNullFD > -1)
+        close(captureNullFD);
+    captureLogFD = captureNullFD = -1;
+
+    if(captureLogPath != NULL)
+        captureLogPath = sfree(captureLogPath);
+    if(captureLogOldPath != NULL)
+        captureLogOldPath = sfree(captureLogOldPath);
+}
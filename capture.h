@@ -0,0 +1,58 @@
+#ifndef BABYBINDS_CAPTURE_H
+#define BABYBINDS_CAPTURE_H
+
+/***** All stuff related to capturing the output of spawned commands *****/
+/* For datatypes */
+#include "datatypes.h"
+
+/* For compile time settings */
+#include "globals.h"
+
+/* For memory management */
+#include "memory.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* For watching the capture pipes */
+#include "eventloop.h"
+
+/* For pid_t */
+#include <sys/types.h>
+
+/* Children's stdout and stderr are never inherited from the daemon. Either:
+ * - They go to non-blocking pipes read by the event loop, and each line is tagged with the bind and the pid and written to
+ *   a size-capped log. The lines of a whole wakeup are written at once (one write, at most BABYBINDS_CAPTURE_FLUSH bytes:
+ *   lines past it are dropped, with a note in the log), so a chatty child costs the event loop a write per wakeup at most
+ *   When the log reaches BABYBINDS_CAPTURE_LOG_SIZE bytes it is rotated to <log path>.1 (replacing the previous one)
+ * - They go straight to /dev/null (discard mode, or if all BABYBINDS_CAPTURE_SLOTS capture slots are in use)
+ * A child that writes too much only fills its own pipe, the daemon never waits for it */
+
+/* Sets up output capturing. If logPath is NULL, ~/.babybinds.log is used. If discard is not 0, output is sent to /dev/null instead
+   Returns 1 on success, 0 on failure */
+int captureInit(const char* logPath, int discard);
+
+/* Prepares the capture pipes for a command of a bind, before forking
+   Returns the capture slot to pass to the other capture functions, or -1 if output is to be discarded */
+int captureSetup(size_t bind);
+
+/* Redirects stdout and stderr of the calling (freshly forked) child to the capture slot (or /dev/null if slot is -1) */
+void captureChild(int slot);
+
+/* Finishes setting up a capture slot in the parent after forking, starting to watch the pipes */
+void captureParent(int slot, pid_t pid);
+
+/* Frees a capture slot if forking failed */
+void captureAbort(int slot);
+
+/* Handles a finished read from a capture pipe (called by the event loop with LK_capture completions). Its lines are only
+   queued, see captureFlush */
+void captureHandle(const struct loopCompletion* completion);
+
+/* Writes the queued lines to the log. Called once per event loop wakeup, after all completions */
+void captureFlush(void);
+
+/* Closes all pipes and the log and frees memory */
+void captureShutdown(void);
+
+#endif
@@ -0,0 +1,316 @@
+/***** compile.h implementation *****/
+#include "compile.h"
+
+/* For errno */
+#include <errno.h>
+#include <string.h>
+
+/* For checking if the default matcher exists */
+#include <unistd.h>
+
+/* For loading shared objects */
+#include <dlfcn.h>
+
+/* Loaded matcher handle and symbols */
+static void* matcherHandle = NULL;
+static long (*matcherCombo)(size_t, const int*, size_t) = NULL;
+static long (*matcherSingle)(size_t, int) = NULL;
+static char* const* const* matcherExecs = NULL;
+
+/*** Internal functions ***/
+/* Compares two binds by scope, size and then keycodes, and then bind number (so that the first of equal binds comes first, like in the generic matcher) */
+static int compileCompareBinds(const void* a, const void* b);
+
+/* Writes a C string literal */
+static void compileWriteString(FILE* out, const char* str);
+
+/* Writes the nested switches for the binds in sorted[lo, hi) (all the same size), starting at keycode depth
+   The switch is on the expression value, indented by indent levels. Nested switches are on codes[depth + 1] */
+static void compileWriteSwitch(FILE* out, const size_t* sorted, size_t lo, size_t hi, size_t depth, size_t indent, const char* value);
+
+/*** Implementations ***/
+static int compileCompareBinds(const void* a, const void* b) {
+    const size_t ia = *(const size_t*)a;
+    const size_t ib = *(const size_t*)b;
+    size_t n;
+
+    if(comboBinds[ia].scope != comboBinds[ib].scope)
+        return comboBinds[ia].scope < comboBinds[ib].scope ? -1 : 1;
+
+    if(comboBinds[ia].size != comboBinds[ib].size)
+        return comboBinds[ia].size < comboBinds[ib].size ? -1 : 1;
+
+    for(n = 0; n < comboBinds[ia].size; ++n) {
+        if(comboBinds[ia].codes[n] != comboBinds[ib].codes[n])
+            return comboBinds[ia].codes[n] < comboBinds[ib].codes[n] ? -1 : 1;
+    }
+
+    if(ia != ib)
+        return ia < ib ? -1 : 1;
+
+    return 0;
+}
+
+static void compileWriteString(FILE* out, const char* str) {
+    fputc('"', out);
+    for(; *str != '\0'; ++str) {
+        const unsigned char c = (unsigned char)*str;
+
+        if(c == '"' || c == '\\') {
+            fputc('\\', out);
+            fputc(c, out);
+        }
+        else if(c < 32 || c > 126)
+            fprintf(out, "\\%03o", c); /* Octal escapes never eat the following characters, unlike hex ones */
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void compileWriteSwitch(FILE* out, const size_t* sorted, size_t lo, size_t hi, size_t depth, size_t indent, const char* value) {
+    /* Indentation of the switch and of its cases' contents */
+    const int spaces = (int)((indent + depth) * 4);
+    size_t i;
+
+    fprintf(out, "%*sswitch(%s) {\n", spaces, "", value);
+    i = lo;
+    while(i < hi) {
+        /* Group all binds with the same keycode at this depth */
+        const int code = comboBinds[sorted[i]].codes[depth];
+        size_t groupEnd = i + 1;
+
+        while(groupEnd < hi && comboBinds[sorted[groupEnd]].codes[depth] == code)
+            ++groupEnd;
+
+        fprintf(out, "%*scase %d:\n", spaces, "", code);
+        if(depth + 1 == comboBinds[sorted[i]].size) {
+            /* Last keycode. If the combo is repeated, the first bind wins (it is the first of the group) */
+            fprintf(out, "%*sreturn %lu;\n", spaces + 4, "", (unsigned long)sorted[i]);
+        }
+        else {
+            char nextValue[32];
+
+            sprintf(nextValue, "codes[%lu]", (unsigned long)(depth + 1));
+            compileWriteSwitch(out, sorted, i, groupEnd, depth + 1, indent, nextValue);
+            fprintf(out, "%*sbreak;\n", spaces + 4, "");
+        }
+
+        i = groupEnd;
+    }
+    fprintf(out, "%*s}\n", spaces, "");
+}
+
+int compileConfig(const char* outPath) {
+    FILE* out;
+    size_t* sorted;
+    size_t i;
+    size_t n;
+
+    if(strcmp(outPath, "-") == 0)
+        out = stdout;
+    else {
+        out = fopen(outPath, "w");
+        if(out == NULL) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Could not open compiled matcher output: ", strerror(errno));
+            return 0;
+        }
+    }
+
+    /* Header and identification */
+    fputs("/* Generated by babybinds --compile. Do not edit, re-generate instead\n", out);
+    fputs("   Build with: cc -shared -fPIC -O2 -o ~/.babybindsrc.so <this file> */\n", out);
+    fputs("#include <stddef.h>\n\n", out);
+    fprintf(out, "const unsigned long babybindsMatcherABI = %d;\n", BABYBINDS_MATCHER_ABI);
+    fprintf(out, "const unsigned long babybindsMatcherHash = %luUL;\n\n", configHash);
+
+    /* Argv tables */
+    for(i = 0; i < bindNum; ++i) {
+        fprintf(out, "static char* const bind%lu[] = { ", (unsigned long)i);
+        for(n = 0; comboExecs[i].elems[n] != NULL; ++n) {
+            compileWriteString(out, comboExecs[i].elems[n]);
+            fputs(", ", out);
+        }
+        fputs("NULL };\n", out);
+    }
+
+    fputs("\nchar* const* const babybindsMatcherExecs[] = {\n", out);
+    for(i = 0; i < bindNum; ++i)
+        fprintf(out, "    bind%lu,\n", (unsigned long)i);
+    fputs("    NULL\n};\n\n", out);
+
+    /* Sort binds so that equal keycode prefixes are next to each other */
+    sorted = salloc(NULL, sizeof(size_t) * (bindNum + 1));
+    if(salloc_f()) {
+        if(out != stdout)
+            fclose(out);
+        return 0;
+    }
+
+    for(i = 0; i < bindNum; ++i)
+        sorted[i] = i;
+    qsort(sorted, bindNum, sizeof(size_t), compileCompareBinds);
+
+    /* Single-key matcher, a switch on the scope and then on the keycode (single-key binds are sorted first in each scope) */
+    fputs("long babybindsMatchSingle(size_t scope, int code) {\n", out);
+    fputs("    switch(scope) {\n", out);
+    i = 0;
+    while(i < bindNum) {
+        const size_t scope = comboBinds[sorted[i]].scope;
+        size_t scopeEnd = i;
+
+        while(scopeEnd < bindNum && comboBinds[sorted[scopeEnd]].scope == scope && comboBinds[sorted[scopeEnd]].size == 1)
+            ++scopeEnd;
+
+        if(scopeEnd > i) {
+            fprintf(out, "    case %lu:\n", (unsigned long)scope);
+            compileWriteSwitch(out, sorted, i, scopeEnd, 0, 2, "code");
+            fputs("        break;\n", out);
+        }
+
+        /* Skip the multi-key binds of this scope */
+        while(scopeEnd < bindNum && comboBinds[sorted[scopeEnd]].scope == scope)
+            ++scopeEnd;
+        i = scopeEnd;
+    }
+    fputs("    }\n", out);
+    fputs("    return -1;\n}\n\n", out);
+
+    /* Multi-key matcher, a switch on the scope, then on the size and then nested switches on each keycode */
+    fputs("long babybindsMatchCombo(size_t scope, const int* codes, size_t size) {\n", out);
+    fputs("    switch(scope) {\n", out);
+    i = 0;
+    while(i < bindNum) {
+        const size_t scope = comboBinds[sorted[i]].scope;
+        size_t scopeEnd;
+
+        /* Skip the single-key binds of this scope */
+        while(i < bindNum && comboBinds[sorted[i]].scope == scope && comboBinds[sorted[i]].size == 1)
+            ++i;
+        scopeEnd = i;
+        while(scopeEnd < bindNum && comboBinds[sorted[scopeEnd]].scope == scope)
+            ++scopeEnd;
+
+        if(scopeEnd > i) {
+            fprintf(out, "    case %lu:\n", (unsigned long)scope);
+            fputs("        switch(size) {\n", out);
+            while(i < scopeEnd) {
+                const size_t size = comboBinds[sorted[i]].size;
+                size_t sizeEnd = i + 1;
+
+                while(sizeEnd < scopeEnd && comboBinds[sorted[sizeEnd]].size == size)
+                    ++sizeEnd;
+
+                fprintf(out, "        case %lu:\n", (unsigned long)size);
+                compileWriteSwitch(out, sorted, i, sizeEnd, 0, 3, "codes[0]");
+                fputs("            break;\n", out);
+
+                i = sizeEnd;
+            }
+            fputs("        }\n", out);
+            fputs("        break;\n", out);
+        }
+
+        i = scopeEnd;
+    }
+    fputs("    }\n", out);
+    fputs("    return -1;\n}\n", out);
+
+    sfree(sorted);
+
+    if(out != stdout && fclose(out) != 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not write compiled matcher: ", strerror(errno));
+        return 0;
+    }
+
+    return 1;
+}
+
+void matcherLoad(const char* path) {
+    char* defaultPath = NULL;
+    const unsigned long* abi;
+    const unsigned long* hash;
+
+    /* Get default path (size of home path + size of /.babybindsrc.so (16) + null-terminator size (1)) */
+    if(path == NULL) {
+        const char* homePath = getenv("HOME");
+
+        if(homePath == NULL)
+            return;
+
+        defaultPath = salloc(NULL, strlen(homePath) + 17);
+        if(salloc_f())
+            return;
+
+        strcpy(defaultPath, homePath);
+        strcat(defaultPath, "/.babybindsrc.so");
+
+        /* Not having a compiled matcher is the normal case */
+        if(access(defaultPath, F_OK) == -1) {
+            sfree(defaultPath);
+            return;
+        }
+    }
+
+    matcherHandle = dlopen(path == NULL ? defaultPath : path, RTLD_NOW | RTLD_LOCAL);
+    if(defaultPath != NULL)
+        sfree(defaultPath);
+
+    if(matcherHandle == NULL) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not load compiled matcher, using generic matcher: ", dlerror());
+        return;
+    }
+
+    abi = dlsym(matcherHandle, "babybindsMatcherABI");
+    hash = dlsym(matcherHandle, "babybindsMatcherHash");
+    *(void**)&matcherCombo = dlsym(matcherHandle, "babybindsMatchCombo");
+    *(void**)&matcherSingle = dlsym(matcherHandle, "babybindsMatchSingle");
+    matcherExecs = dlsym(matcherHandle, "babybindsMatcherExecs");
+
+    if(abi == NULL || hash == NULL || matcherCombo == NULL || matcherSingle == NULL || matcherExecs == NULL || *abi != BABYBINDS_MATCHER_ABI) {
+        taggedMsg(TM_warning | TM_flush | TM_newline, "Compiled matcher is not valid, using generic matcher");
+        matcherShutdown();
+        return;
+    }
+
+    if(*hash != configHash) {
+        taggedMsg(TM_warning | TM_flush | TM_newline, "Compiled matcher was compiled from another config, using generic matcher (re-run babybinds --compile)");
+        matcherShutdown();
+        return;
+    }
+
+    /* Compiled matchers have every profile section, so their bind numbers only match if every section was built */
+    if(skippedProfiles > 0) {
+        taggedMsg(TM_info | TM_flush | TM_newline, "Some profile sections have no device, using generic matcher.");
+        matcherShutdown();
+        return;
+    }
+
+    taggedMsg(TM_info | TM_flush | TM_newline, "Using compiled matcher.");
+}
+
+int matcherLoaded(void) {
+    return matcherHandle != NULL;
+}
+
+long matcherFindCombo(size_t scope, const int* codes, size_t size) {
+    return matcherCombo(scope, codes, size);
+}
+
+long matcherFindSingle(size_t scope, int code) {
+    return matcherSingle(scope, code);
+}
+
+char** matcherExec(size_t bind) {
+    return (char**)matcherExecs[bind];
+}
+
+void matcherShutdown(void) {
+    if(matcherHandle != NULL)
+        dlclose(matcherHandle);
+
+    matcherHandle = NULL;
+    matcherCombo = NULL;
+    matcherSingle = NULL;
+    matcherExecs = NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef BABYBINDS_COMPILE_H
+#define BABYBINDS_COMPILE_H
+
+/***** All stuff related to compiling the config into a C matcher and loading it *****/
+/* For datatypes */
+#include "datatypes.h"
+
+/* For bind globals */
+#include "globals.h"
+
+/* For memory management */
+#include "memory.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* Version of the compiled matcher interface. Matchers compiled for another version are not loaded */
+#define BABYBINDS_MATCHER_ABI 2
+
+/* A compiled matcher is a shared object built from C source generated by compileConfig. It exports:
+ * - const unsigned long babybindsMatcherABI:  BABYBINDS_MATCHER_ABI
+ * - const unsigned long babybindsMatcherHash: configHash of the config it was compiled from
+ * - long babybindsMatchCombo(size_t scope, const int* codes, size_t size): bind of an ordered multi-key combo in a scope, or -1
+ * - long babybindsMatchSingle(size_t scope, int code): single-key bind of a key in a scope, or -1
+ * - char* const* const babybindsMatcherExecs[]: the argv of each bind (null terminated). Binds with placeholders are expanded
+ *   from their template instead, so theirs is never used
+ * The matchers are nested switches on the scope and each keycode, so the compiler can turn them into jump tables or binary searches
+ * Bind numbers are the same as the generic tables, as they come from the same config, which is still loaded (for the fallback) */
+
+/* Generates the C source of a matcher for the loaded config and writes it to outPath ("-" for stdout)
+   Returns 1 on success, 0 on failure */
+int compileConfig(const char* outPath);
+
+/* Loads a compiled matcher. If path is NULL, ~/.babybindsrc.so is tried, and it not existing is not a warning
+   If the matcher can't be loaded or was compiled from another config, the generic matcher is used */
+void matcherLoad(const char* path);
+
+/* Returns 1 if a compiled matcher is loaded */
+int matcherLoaded(void);
+
+/* Compiled matcher lookups (only call if matcherLoaded). Return the bind number or -1 if there is no such bind */
+long matcherFindCombo(size_t scope, const int* codes, size_t size);
+long matcherFindSingle(size_t scope, int code);
+
+/* Argv of a bind from the compiled matcher (only call if matcherLoaded) */
+char** matcherExec(size_t bind);
+
+/* Unloads the compiled matcher */
+void matcherShutdown(void);
+
+#endif
@@ -1,29 +1,200 @@
 /***** config.h implementation *****/
 #include "config.h"
 
-int addKeybind(int* keycodes, size_t keycodesSize, char* exec, size_t execSize) {
-    /*** Basic variable set-up ***/
+/* For telling directives from keycodes */
+#include <ctype.h>
+
+/* For memset */
+#include <string.h>
+
+/* Profile section state of a config file */
+struct configProfile {
+    /* Scope of the binds in the section, 0 outside of one */
+    size_t scope;
+    /* 1 if the section is skipped, as no device has its name */
+    int skipped;
+};
+
+/*** Internal functions ***/
+/* Makes the path of an included file: absolute paths are kept, ~/ is the home directory and anything else is relative to
+   the directory of the including file. Returns the allocated path, or NULL on failure */
+static char* configIncludePath(const char* includer, const char* path);
+
+/* Runs a directive line (null terminated, read from the file at path):
+   - include <path>: parses another file there, in the current profile section (not read at all if the section is skipped)
+   - profile <name>: binds until the end of the file (or an end directive) are scoped to the device label or group name
+     If no device has that name, the section is skipped: its binds are not added, so no table or index is built for them
+   - end: ends the profile section
+   Returns 1 on success, 0 on failure (prints an error message) */
+static int configDirective(char* line, const char* path, size_t depth, const struct configProfile* inherited, struct configProfile* profile);
+
+/* Parses a config file, adding its binds (see loadConfig). The file starts in the inherited profile section
+   depth is the number of includes that led to this file. Returns 1 on success, 0 on failure (prints an error message) */
+static int configLoadFile(const char* path, size_t depth, const struct configProfile* inherited);
+
+/*** Implementations ***/
+static char* configIncludePath(const char* includer, const char* path) {
+    const char* base;
+    size_t baseSize;
+    char* result;
+
+    if(path[0] == '/') {
+        base = "";
+        baseSize = 0;
+    }
+    else if(path[0] == '~' && path[1] == '/') {
+        base = getenv("HOME");
+        if(base == NULL) {
+            taggedMsg(TM_error | TM_flush | TM_newline, "Could not get home path for an include!");
+            return NULL;
+        }
+        baseSize = strlen(base);
+        ++path; /* Keep the slash */
+    }
+    else {
+        /* Directory of the includer, with its trailing slash (nothing if it has no directory) */
+        const char* slash = strrchr(includer, '/');
+
+        base = includer;
+        baseSize = (slash == NULL) ? 0 : (size_t)(slash - includer) + 1;
+    }
+
+    result = salloc(NULL, baseSize + strlen(path) + 1);
+    if(salloc_f())
+        return NULL;
+
+    memcpy(result, base, baseSize);
+    strcpy(result + baseSize, path);
+    return result;
+}
+
+static int configDirective(char* line, const char* path, size_t depth, const struct configProfile* inherited, struct configProfile* profile) {
+    char* argument;
+    char* end;
+
+    /* Split the keyword from the argument and drop trailing spaces and tabs */
+    end = line + strlen(line);
+    while(end > line && (end[-1] == ' ' || end[-1] == '\t'))
+        *--end = '\0';
+
+    argument = line + strcspn(line, " \t");
+    if(*argument != '\0') {
+        *argument++ = '\0';
+        argument += strspn(argument, " \t");
+    }
+
+    if(strcmp(line, "include") == 0 && *argument != '\0') {
+        char* includePath;
+        int success;
+
+        /* Files of skipped sections aren't even read */
+        if(profile->skipped)
+            return 1;
+
+        if(depth + 1 > BABYBINDS_INCLUDE_DEPTH) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Configuration includes are nested too deep (include loop?): ", argument);
+            return 0;
+        }
+
+        includePath = configIncludePath(path, argument);
+        if(includePath == NULL)
+            return 0;
+
+        success = configLoadFile(includePath, depth + 1, profile);
+        sfree(includePath);
+        return success;
+    }
+    else if(strcmp(line, "profile") == 0 && *argument != '\0') {
+        if(profile->scope != 0 || profile->skipped) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Malformed configuration file: Profile sections can't be nested: ", argument);
+            return 0;
+        }
+
+        /* Without devices (compile mode) every section is built */
+        profile->skipped = deviceCount() > 0 && !deviceHasName(argument);
+        if(profile->skipped) {
+            ++skippedProfiles;
+            return 1;
+        }
+
+        profile->scope = addScope(argument, strlen(argument));
+        return profile->scope != 0;
+    }
+    else if(strcmp(line, "end") == 0 && *argument == '\0') {
+        /* Only sections started in this file can be ended in it */
+        if(profile->scope == inherited->scope && profile->skipped == inherited->skipped) {
+            taggedMsg(TM_error | TM_flush | TM_newline, "Malformed configuration file: end without profile section");
+            return 0;
+        }
+
+        *profile = *inherited;
+        return 1;
+    }
+
+    taggedMsg2(TM_error | TM_flush | TM_newline, "Malformed configuration file: Unknown or incomplete directive: ", line);
+    return 0;
+}
+
+
+size_t findScope(const char* name, size_t nameSize) {
+    size_t n;
+
+    for(n = 0; n < scopeNum; ++n) {
+        if(strlen(scopeNames[n]) == nameSize && memcmp(scopeNames[n], name, nameSize) == 0)
+            return n + 1;
+    }
+
+    return 0;
+}
+
+size_t addScope(const char* name, size_t nameSize) {
+    /* Already known? */
+    const size_t known = findScope(name, nameSize);
+
+    if(known != 0)
+        return known;
+
+    /* Expand the names array and copy the name. Return 0 on failure */
+    scopeNames = salloc(scopeNames, sizeof(char*) * (scopeNum + 1));
+    if(salloc_f())
+        return 0; /* Out of memory! */
+
+    scopeNames[scopeNum] = salloc(NULL, nameSize + 1);
+    if(salloc_f())
+        return 0; /* Out of memory! */
+
+    memcpy(scopeNames[scopeNum], name, nameSize);
+    scopeNames[scopeNum][nameSize] = '\0';
+
+    return ++scopeNum;
+}
+
+int addKeybind(size_t scope, int* keycodes, size_t keycodesSize, char* exec, size_t execSize) {
     /* Declare thisNum for convenience and increment bind counter */
     const size_t thisNum = bindNum++;
-    
-    /* Other loop iterators and variables */
-    size_t n;
-    enum unserializeMode addNext;
-    char* c;
-    
+
     /*** Allocate main arrays ***/
-    /* Allocate space for both structs and set their default values. Return 0 on failure */
-  
+    /* Allocate space for both structs. Return 0 on failure */
     comboBinds = salloc(comboBinds, sizeof(struct keyCombo) * bindNum);
     if(salloc_f())
         return 0; /* Out of memory! */
 
-    comboBinds[thisNum] = defaultKeyCombo;
-
     comboExecs = salloc(comboExecs, sizeof(struct keyExec) * bindNum);
     if(salloc_f())
         return 0; /* Out of memory! */
 
+    return setKeybind(thisNum, scope, keycodes, keycodesSize, exec, execSize);
+}
+
+int setKeybind(size_t thisNum, size_t scope, int* keycodes, size_t keycodesSize, char* exec, size_t execSize) {
+    /* Loop iterators and variables */
+    size_t n;
+    enum unserializeMode addNext;
+    char* c;
+
+    /* Set their default values */
+    comboBinds[thisNum] = defaultKeyCombo;
+    comboBinds[thisNum].scope = scope;
     comboExecs[thisNum] = defaultKeyExec;
 
     /*** Set actual values to comboBinds ***/
@@ -32,12 +203,10 @@ int addKeybind(int* keycodes, size_t keycodesSize, char* exec, size_t execSize)
     if(salloc_f())
         return 0; /* Out of memory! */
 
-    /* Update size */
-    comboBinds[thisNum].size = keycodesSize;
-
-    /* Update keycodes */
+    /* Update keycodes, ordered from smallest to biggest like the combo buffer (repeated keycodes are dropped) */
+    comboBinds[thisNum].size = 0;
     for(n = 0; n < keycodesSize; ++n)
-        comboBinds[thisNum].codes[n] = keycodes[n];
+        comboBinds[thisNum].size = intPtrOrderedUniqueInsert(comboBinds[thisNum].codes, comboBinds[thisNum].size, keycodes[n]);
 
     /*** Set actual values to comboExecs ***/
     /* Allocate space for the data array. Return 0 on failure */
@@ -96,16 +265,107 @@ int addKeybind(int* keycodes, size_t keycodesSize, char* exec, size_t execSize)
             addNext = USM_push;
     }
 
+    /* Compile placeholders once, so triggering only fills them in. Return 0 on failure */
+    if(!templateCompile(&comboExecs[thisNum]))
+        return 0;
+
     /* All (finally) done! */
     return 1;
 }
 
-void loadConfig(void) {
-    /* Paths and files */
-    char* homePath;
-    char* configPath;
+void dropBind(size_t bind) {
+    if(comboBinds[bind].codes == NULL)
+        return;
+
+    /* Plugin binds use the command as arguments, so unload the plugin first */
+    pluginDrop(bind);
+    templateFree(&comboExecs[bind]);
+
+    comboBinds[bind].codes = sfree(comboBinds[bind].codes);
+    comboBinds[bind].size = 0;
+    comboExecs[bind].elems = sfree(comboExecs[bind].elems);
+    comboExecs[bind].data = sfree(comboExecs[bind].data);
+    comboExecs[bind].size = 0;
+}
+
+void dropScope(size_t scope) {
+    size_t i;
+
+    for(i = 0; i < bindNum; ++i) {
+        if(comboBinds[i].scope == scope)
+            dropBind(i);
+    }
+
+    if(matcherLoaded()) {
+        taggedMsg(TM_info | TM_flush | TM_newline, "Binds were dropped, using generic matcher.");
+        matcherShutdown();
+    }
+
+    /* The dropped binds must leave the keycode index, and binds they were supersets of can trigger right away now */
+    indexKeybinds();
+}
+
+void indexKeybinds(void) {
+    size_t i;
+    size_t j;
+
+    /* Keycode index. Binds are walked backwards so that each keycode's chain of single-key binds is in bind order
+       Keycodes no event can have (KEY_CNT or more) are left out, as their binds never trigger anyway */
+    memset(singleBindIndex, 0, sizeof(singleBindIndex));
+    memset(comboKeyMap, 0, sizeof(comboKeyMap));
+    for(i = bindNum; i-- > 0;) {
+        const int* codes = comboBinds[i].codes;
+
+        comboBinds[i].nextSingle = 0;
+        if(comboBinds[i].size == 1 && codes[0] < KEY_CNT) {
+            comboBinds[i].nextSingle = singleBindIndex[codes[0]];
+            singleBindIndex[codes[0]] = i + 1;
+        }
+        else if(comboBinds[i].size > 1) {
+            for(j = 0; j < comboBinds[i].size; ++j) {
+                if(codes[j] < KEY_CNT)
+                    comboKeyMap[codes[j] / 8] |= (unsigned char)(1 << (codes[j] % 8));
+            }
+        }
+    }
+
+    for(i = 0; i < bindNum; ++i) {
+        comboBinds[i].hasSuperset = 0;
+
+        /* Single-key binds are triggered on release, so they are never ambiguous */
+        if(comboBinds[i].size < 2)
+            continue;
+
+        for(j = 0; j < bindNum && !comboBinds[i].hasSuperset; ++j) {
+            size_t ni;
+            size_t nj;
+
+            /* Binds of different scopes are matched against different views, so they never overlap */
+            if(comboBinds[j].size <= comboBinds[i].size || comboBinds[j].scope != comboBinds[i].scope)
+                continue;
+
+            /* Both are ordered, so check if j contains all of i's keycodes by walking them at the same time */
+            ni = 0;
+            for(nj = 0; nj < comboBinds[j].size && ni < comboBinds[i].size; ++nj) {
+                if(comboBinds[j].codes[nj] == comboBinds[i].codes[ni])
+                    ++ni;
+                else if(comboBinds[j].codes[nj] > comboBinds[i].codes[ni])
+                    break; /* Missing keycode */
+            }
+
+            if(ni == comboBinds[i].size)
+                comboBinds[i].hasSuperset = 1;
+        }
+    }
+}
+
+static int configLoadFile(const char* path, size_t depth, const struct configProfile* inherited) {
+    /* File */
     FILE* configFP;
 
+    /* Profile section the binds are added to */
+    struct configProfile profile;
+
     /* Readmode for parsing */
     enum readMode mode;
 
@@ -121,42 +381,26 @@ void loadConfig(void) {
     int parsedCombos[BABYBINDS_COMBOBUFFER_SIZE];
     size_t parsedCombosI;
 
+    /* Scope of the bind being parsed (0 if it has none) */
+    size_t parsedScope;
+
     /* Pre-computed array of positive powers of 10 (for str to positive int convertion). Max is 10 ^ 7 (8 digit keycode) */
     static const int pow10[8] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
 
-    /* Get configuration file path
-       First, get the home path */
-    homePath = getenv("HOME");
-    if(homePath == NULL) {
-        taggedMsg(TM_error | TM_flush | TM_newline, "Could not get home path! Aborting...");
-        exit(EXIT_FAILURE);
-        /* No need for graceful shutdown, as no I/O or dynamic memory outside this function has been fidled with
-           This applies for every exit in this function outside the parse loop */
-    }
-
-    /* Then, allocate space for the variable (size of home path + size of /.babybindsrc (13) + null-terminator size (1) */
-    configPath = salloc(NULL, strlen(getenv("HOME")) + 14);
-    if(salloc_f())
-        exit(EXIT_FAILURE);
-
-    /* Then, append home path to it */
-    strcpy(configPath, homePath);
-
-    /* Finally, append the config file name to the end */
-    strcat(configPath, "/.babybindsrc");
-
     /* Open configuration file */
-    configFP = fopen(configPath, "r");
+    configFP = fopen(path, "r");
     if(configFP == NULL) {
-        taggedMsg2(TM_error | TM_flush | TM_newline, "~/.babybindsrc could not be opened: ", strerror(errno));
-        sfree(configPath);
-        exit(EXIT_FAILURE);
+        taggedMsg2(TM_error | TM_flush, "Configuration file could not be opened: ", (char*)path);
+        fprintf(stderr, " (%s)\n", strerror(errno));
+        return 0;
     }
 
     /* Prepare variables for parsing
        Read modes:
        -=-=-=-=-=-
-       RM_starting: Starting (after a newline, will check if the first char is a # for going into escape mode)
+       RM_starting: Starting (after a newline, will check if the first char is a # for going into escape mode or a [ for scope mode)
+       RM_scope   : Bind scope (device label or group)
+       RM_directive: Directive (include, profile or end)
        RM_keycode : Keycode
        RM_command : Shell command
        RM_escape  : Escape next character (shell command mode)
@@ -168,39 +412,68 @@ void loadConfig(void) {
     databufI = 0;
     databuf = salloc(NULL, databufSize);
     if(salloc_f()) {
-        sfree(configPath);
         fclose(configFP);
-        exit(EXIT_FAILURE);
+        return 0;
     }
     
     /* Initialize combo array stuff */
     parsedCombosI = 0;
+    parsedScope = 0;
 
-    /* Start parsing */
+    /* The file starts in the profile section it was included from */
+    profile = *inherited;
+
+    /* Start parsing (the hash goes on from the previous file) */
     do {
-        /* Update character */
+        /* Update character and the config hash */
         c = fgetc(configFP);
+        if(c != EOF)
+            configHash = BABYBINDS_HASH_STEP(configHash, c);
 
-        /* Ignore spaces and tabs unless in command mode */
-        if(mode != RM_command && mode != RM_escape && (c == ' ' || c == '\t'))
+        /* Ignore spaces and tabs unless in command or directive mode */
+        if(mode != RM_command && mode != RM_escape && mode != RM_directive && (c == ' ' || c == '\t'))
             continue;
 
         /* If in starting mode, check for comment */
         if(mode == RM_starting) {
             if(c == '#')
                 mode = RM_comment;
+            else if(c == '[') {
+                mode = RM_scope;
+                continue;
+            }
+            else if(isalpha(c))
+                mode = RM_directive; /* Keycodes are numbers, so a letter starts a directive */
         }
 
         /* Check for newlines and EOF to save the parsed data */
         if(c == '\n' || c == EOF) {
-            if(mode == RM_keycode) {
+            if(mode == RM_keycode || mode == RM_scope) {
                 taggedMsg(TM_error | TM_flush | TM_newline, "Malformed configuration file: Incomplete keybind (missing shell action)");
                 mode = RM_error;
                 break;
             }
+            else if(mode == RM_directive) {
+                /* Null terminate the line (there is always room, the buffer is expanded before it is full) and run it */
+                databuf[databufI] = '\0';
+                if(!configDirective(databuf, path, depth, inherited, &profile)) {
+                    mode = RM_error;
+                    break;
+                }
+
+                /* "Clear" the buffer */
+                databufI = 0;
+            }
             else if(mode == RM_command || mode == RM_escape) {
-                /* Push data */
-                if(!addKeybind(parsedCombos, parsedCombosI, databuf, databufI)) {
+                /* A bind can't be in two scopes */
+                if(parsedScope != 0 && (profile.scope != 0 || profile.skipped)) {
+                    taggedMsg(TM_error | TM_flush | TM_newline, "Malformed configuration file: Scoped bind inside a profile section");
+                    mode = RM_error;
+                    break;
+                }
+
+                /* Push data, unless the profile section is skipped */
+                if(!profile.skipped && !addKeybind(parsedScope != 0 ? parsedScope : profile.scope, parsedCombos, parsedCombosI, databuf, databufI)) {
                     mode = RM_error;
                     break;
                 }
@@ -208,6 +481,7 @@ void loadConfig(void) {
                 /* "Clear" the buffers */
                 databufI = 0;
                 parsedCombosI = 0;
+                parsedScope = 0;
             }
 
             /* Return to starting mode */
@@ -219,8 +493,26 @@ void loadConfig(void) {
             if(mode == RM_starting)
                 mode = RM_keycode;
 
+            /* End of the scope: store it and go on with the keycodes */
+            if(mode == RM_scope && c == ']') {
+                if(databufI == 0) {
+                    taggedMsg(TM_error | TM_flush | TM_newline, "Malformed configuration file: Empty bind scope");
+                    mode = RM_error;
+                    break;
+                }
+
+                parsedScope = addScope(databuf, databufI);
+                if(parsedScope == 0) {
+                    mode = RM_error;
+                    break;
+                }
+
+                /* "Clear" the buffer */
+                databufI = 0;
+                mode = RM_keycode;
+            }
             /* Parse data in buffer if switching mode */
-            if((c == ';' || c == ':') && mode != RM_command && mode != RM_escape) {
+            else if((c == ';' || c == ':') && mode != RM_command && mode != RM_escape && mode != RM_scope && mode != RM_directive) {
                 int parsedInt;
                 size_t n;
                 
@@ -277,8 +569,8 @@ void loadConfig(void) {
                 databufI = 0;
             }
             else {
-                /* Expand the buffer to 2x its size if needed */
-                if(databufI == databufSize) {
+                /* Expand the buffer to 2x its size if needed (directives need room for a null terminator too) */
+                if(databufI == databufSize || (mode == RM_directive && databufI + 1 == databufSize)) {
                     databufSize *= 2;
                     databuf = salloc(databuf, databufSize);
                     if(salloc_f()) {
@@ -287,7 +579,7 @@ void loadConfig(void) {
                     }
                 }
 
-                if(mode == RM_keycode) { /* Keycode mode: just insert */
+                if(mode == RM_keycode || mode == RM_scope || mode == RM_directive) { /* Keycode, scope and directive modes: just insert */
                     /* Append data to buffer */
                     databuf[databufI++] = c;
                 }
@@ -326,11 +618,53 @@ void loadConfig(void) {
 
     /* Clean-up this mess */
     fclose(configFP);
-    sfree(configPath);
     sfree(databuf);
-    if(mode == RM_error) {
+
+    return mode != RM_error;
+}
+
+void loadConfig(const char* path) {
+    /* Outside of any profile section */
+    static const struct configProfile noProfile = { 0, 0 };
+    char* defaultPath = NULL;
+    int success;
+
+    /* Get default configuration file path */
+    if(path == NULL) {
+        /* First, get the home path */
+        const char* homePath = getenv("HOME");
+
+        if(homePath == NULL) {
+            taggedMsg(TM_error | TM_flush | TM_newline, "Could not get home path! Aborting...");
+            shutdownDaemon();
+            exit(EXIT_FAILURE);
+        }
+
+        /* Then, allocate space for the variable (size of home path + size of /.babybindsrc (13) + null-terminator size (1) */
+        defaultPath = salloc(NULL, strlen(homePath) + 14);
+        if(salloc_f()) {
+            shutdownDaemon();
+            exit(EXIT_FAILURE);
+        }
+
+        /* Finally, append the config file name to the home path */
+        strcpy(defaultPath, homePath);
+        strcat(defaultPath, "/.babybindsrc");
+    }
+
+    /* Parse it and everything it includes */
+    configHash = BABYBINDS_HASH_INIT;
+    skippedProfiles = 0;
+    success = configLoadFile(path == NULL ? defaultPath : path, 0, &noProfile);
+    if(defaultPath != NULL)
+        sfree(defaultPath);
+
+    if(!success) {
         shutdownDaemon();
         exit(EXIT_FAILURE);
     }
+
+    /* Precompute relations between binds */
+    indexKeybinds();
 }
 
@@ -10,22 +10,50 @@
 /* For clean-up */
 #include "call.h"
 
-/* Adds a keybind to memory
+/* Finds a bind scope (device label or group) in scopeNames. Note that name is NOT null terminated!
+   Returns the scope number (see keyCombo.scope), or 0 if it is not there */
+size_t findScope(const char* name, size_t nameSize);
+
+/* Adds a bind scope (device label or group) to scopeNames if it is not there yet
+   Note that name is NOT null terminated! That is why nameSize is needed
+   Returns the scope number (see keyCombo.scope), or 0 on failure (out of memory) */
+size_t addScope(const char* name, size_t nameSize);
+
+/* Adds a keybind to memory, restricted to a scope (0 for any device)
    Note that exec is NOT null terminated! That is why execSize is needed
    The keybind structs:
-     keyCombo { codes, size }* comboBinds
+     keyCombo { codes, size, hasSuperset, scope }* comboBinds
      keyExec { data, elems, size }* comboExecs
      bindNum */
-int addKeybind(int* keycodes, size_t keycodesSize, char* exec, size_t execSize);
+int addKeybind(size_t scope, int* keycodes, size_t keycodesSize, char* exec, size_t execSize);
+
+/* Like addKeybind, but puts the keybind in an existing slot (bind number thisNum) that is empty or was dropped, so dropped
+   binds can be replaced instead of growing the tables (the bind number is reused) */
+int setKeybind(size_t thisNum, size_t scope, int* keycodes, size_t keycodesSize, char* exec, size_t execSize);
+
+/* Drops a bind: its keycodes and command are freed and it never matches again. Bind numbers of other binds don't change */
+void dropBind(size_t bind);
+
+/* Drops the binds of a scope (no device has it anymore): their keycodes and commands are freed and they never match again
+   Bind numbers of other binds don't change. The compiled matcher is unloaded, as it would still find them, and the binds are
+   indexed again */
+void dropScope(size_t scope);
+
+/* Precomputes which binds have a superset (see keyCombo.hasSuperset) and the keycode index (see singleBindIndex and comboKeyMap)
+   Done after all binds are added or dropped
+   This is O(bindNum^2 * BABYBINDS_COMBOBUFFER_SIZE), but only runs on config load and when binds come and go */
+void indexKeybinds(void);
 
-/* Loads ~/.babybindsrc, which contains all keybinds
+/* Loads a config file (~/.babybindsrc if path is NULL), which contains all keybinds
    # indicate comments (like in shell scripts)
    All spaces, tabs, comments and empty lines are ignored
    ... unless in the shell command string, where spaces and tabs separate arguments
    Format is:
-     <keycode (int)>;<keycode>;<...>:<shell command (string)>
+     [<device label or group>]<keycode (int)>;<keycode>;<...>:<shell command (string)>
    Notes: 
    - the last separator is a colon, not a semicolon
+   - the scope is optional. Without it, the keys can be held on any device (even on different ones). With it, the bind only
+     matches keys held on the device with that label, or on the devices of that group (see device.h)
    - only the first colon indicates the end of keycodes, all other syntax followed counts as the shell code
    - there are character escape sequences (escape character is the backslash [\]):
      - \n for newlines
@@ -35,9 +63,16 @@ int addKeybind(int* keycodes, size_t keycodesSize, char* exec, size_t execSize);
      - it is not possible to escape null characters (strings are terminated by null characters)
        - programs typically handle this by using their own escape sequences anyway, so no worries (until someone complains, which is probably never)
      - invalid escape sequences count as a backspace plus the next character (like if it was not an escape sequence in the first place)
+     - %{keycode}, %{time}, %{device} and %{count} are placeholders filled in when the bind triggers (%%{ for a literal %{, see template.h)
      - note that wildcard expansion is not supported and other special shell characters like quotes and asterisks are counted as regular characters (escape spaces instead!)
    - repeated spaces and tabs which are not escaped are ignored
-   - there may be as many keycodes as possible, but they will be ignored if more than BABYBINDS_COMBOBUFFER_SIZE, discarding the whole combo */
-void loadConfig(void);
+   - there may be as many keycodes as possible, but they will be ignored if more than BABYBINDS_COMBOBUFFER_SIZE, discarding the whole combo
+   Lines starting with a letter are directives:
+     include <path>   Parses another file there (relative paths are relative to this file's directory, ~/ is the home directory)
+     profile <name>   Scopes the binds until the end of the file (or an end) to a device label or group, like [name]
+                      Sections of names no device has are skipped, so their tables are only built for devices that are present
+     end              Ends the profile section
+   Loading the devices before the config is needed for skipping sections. Without devices (compile mode) every section is built */
+void loadConfig(const char* path);
 
 #endif
@@ -14,10 +14,16 @@ struct keyCombo {
     int* codes;
     /* Size of array */
     size_t size;
+    /* 1 if another bind's combo contains all of this combo's keys and more (so triggering this combo is ambiguous until that one is unreachable) */
+    int hasSuperset;
+    /* Device label or group the bind is restricted to (see scopeNames), 0 for any device */
+    size_t scope;
+    /* Single-key binds: next single-key bind of the same keycode (in another scope) plus one, 0 if none (see singleBindIndex) */
+    size_t nextSingle;
 };
 
 /* Default value for keyCombo */
-static const struct keyCombo defaultKeyCombo = { NULL, 0 };
+static const struct keyCombo defaultKeyCombo = { NULL, 0, 0, 0, 0 };
 
 /* The struct array containing all shell executes in the argv format
    Each arg is null terminated so its size is not saved (strlen to get length) */
@@ -28,16 +34,69 @@ struct keyExec {
     char** elems;
     /* Size of elem array */
     size_t size;
+    /* Argument template of the command (see template.h), NULL if it has no placeholders */
+    struct templateExec* tmpl;
 };
 
 /* Default value for keyExec */
-static const struct keyExec defaultKeyExec = { NULL, NULL, 0 };
+static const struct keyExec defaultKeyExec = { NULL, NULL, 0, NULL };
+
+/*** Argument template structs ***/
+/* Holes of argument templates: %{name} placeholders in commands, filled in when the bind triggers
+   Note that the TH_ prefix stands for Template Hole (TH) */
+enum templateHole {
+    TH_literal, /* Not a hole, literal text of the command                                           */
+    TH_keycode, /* %{keycode}: keycode of the event that triggered the bind                          */
+    TH_time,    /* %{time}:    kernel timestamp of that event, as <seconds>.<microseconds>           */
+    TH_device,  /* %{device}:  label of the input device of that event (its path if it has no label) */
+    TH_count    /* %{count}:   number of times the bind triggered, this time included                */
+};
+
+/* A piece of a templated argument: literal text from the command data, or a hole filled in when the bind triggers */
+struct templateSlice {
+    /* Argument (elems index) the slice belongs to. Slices of an argument are consecutive */
+    size_t arg;
+    /* What goes there */
+    enum templateHole hole;
+    /* Literal text (not null terminated) and its size for TH_literal, or the room reserved for the hole */
+    const char* text;
+    size_t size;
+};
+
+/* Compiled command of a bind with placeholders. Expanding it only writes into buffers allocated when it was compiled */
+struct templateExec {
+    /* Slices of the templated arguments, in order */
+    struct templateSlice* slices;
+    size_t sliceNum;
+    /* Argv passed to exec: arguments without placeholders point into the command data, templated ones into buffer */
+    char** argv;
+    /* Expansion buffer, big enough for the longest expansion of every templated argument */
+    char* buffer;
+    size_t bufferSize;
+    /* Times the bind triggered */
+    unsigned long count;
+};
+
+/*** Stats ***/
+/* Counters about what the daemon did, printed on shutdown */
+struct daemonStats {
+    /* Input events read from the device */
+    unsigned long events;
+    /* Key events (presses, releases and repeats) */
+    unsigned long keyEvents;
+    /* Key events dropped by the debounce filter */
+    unsigned long debounced;
+    /* Binds triggered */
+    unsigned long triggers;
+};
 
 /*** Flag enums ***/
 /* Read modes for parsing config file
    Note that the RM_ prefix obviously stands for Read Mode (RM) */
 enum readMode {
     RM_starting, /* Starting mode, to determine if in a comment line or not                */
+    RM_scope,    /* Scope    mode, read next data as a device label or group until a ]     */
+    RM_directive, /* Directive mode, read the rest of the line as a directive (include...) */
     RM_keycode,  /* Keycode  mode, read next data as an integer an keycode number          */
     RM_command,  /* Command  mode, read next data as an escapable string for shell command */
     RM_escape,   /* Escape   mode, escape next character                                   */
@@ -53,6 +112,36 @@ enum unserializeMode {
     USM_terminate /* Terminate mode, null terminate the ARRAY, NOT STRING                                    */
 };
 
+/* Event loop backends
+   Note that the LB_ prefix stands for Loop Backend (LB) */
+enum loopBackend {
+    LB_epoll, /* epoll backend, waits for readiness and then reads each ready file descriptor              */
+    LB_uring  /* io_uring backend, keeps a read posted on every file descriptor and only waits for results */
+};
+
+/* Kinds of file descriptors watched by the event loop, so that completions can be dispatched to the right handler
+   Note that the LK_ prefix stands for Loop Kind (LK) */
+enum loopKind {
+    LK_device,   /* Input device, reads input_event structs            */
+    LK_capture,  /* Output pipe of a child, index is slot * 2 + stream */
+    LK_timer,    /* Deferred bind timer, reads the expiration count    */
+    LK_listen,   /* Listening socket of a reader, accepts executors    */
+    LK_executor, /* Executor connected to a reader, index is its slot  */
+    LK_deadline, /* Registration timer of a reader, reads the count    */
+    LK_reader    /* Reader an executor is connected to                 */
+};
+
+/* A finished read from the event loop */
+struct loopCompletion {
+    /* Kind and index passed to loopAdd */
+    enum loopKind kind;
+    size_t index;
+    /* Buffer passed to loopAdd, where the data was read to */
+    void* buf;
+    /* Number of bytes read, 0 on end of file or -errno on failure (for listeners, the accepted file descriptor or -errno) */
+    long result;
+};
+
 /* Error-level flags for taggedMsg(). Can be mixed together:
  * - First 2 bits represent the error level of the message.
  * - Next bit represent wether to flush or not afther the message is printed.
@@ -0,0 +1,73 @@
+/***** debounce.h implementation *****/
+#include "debounce.h"
+
+/* For memset */
+#include <string.h>
+
+/* Debounce window of each key in microseconds (0 if not debounced)
+   Keys without their own window use the window of all keys, so both can be set in any order */
+static long debounceWindows[KEY_CNT];
+static unsigned char debounceOwnWindow[KEY_CNT / 8 + 1];
+
+/*** Internal functions ***/
+/* Returns 1 if now is less than window microseconds after last, 0 if not (or if now is before last, after a clock jump)
+   Seconds are compared first, so the microseconds never overflow a 32-bit long however big the timestamps are */
+static int debounceInWindow(const struct timeval* last, const struct timeval* now, long window);
+
+/*** Implementations ***/
+static int debounceInWindow(const struct timeval* last, const struct timeval* now, long window) {
+    long elapsed;
+
+    if(now->tv_sec < last->tv_sec || now->tv_sec - last->tv_sec > window / 1000000 + 1)
+        return 0;
+
+    elapsed = (long)(now->tv_sec - last->tv_sec) * 1000000 + (long)(now->tv_usec - last->tv_usec);
+    return elapsed >= 0 && elapsed < window;
+}
+
+void debounceSetWindow(long windowMs) {
+    size_t n;
+
+    for(n = 0; n < KEY_CNT; ++n) {
+        if(!((debounceOwnWindow[n / 8] >> (n % 8)) & 1))
+            debounceWindows[n] = windowMs * 1000;
+    }
+}
+
+int debounceSetKeyWindow(int keycode, long windowMs) {
+    if(keycode < 0 || keycode >= KEY_CNT)
+        return 0;
+
+    debounceWindows[keycode] = windowMs * 1000;
+    debounceOwnWindow[keycode / 8] |= (unsigned char)(1 << (keycode % 8));
+    return 1;
+}
+
+void debounceReset(struct debounceState* state) {
+    memset(state, 0, sizeof(struct debounceState));
+}
+
+int debounceFilter(struct debounceState* state, const struct input_event* ev) {
+    int down;
+
+    if(ev->type != EV_KEY || ev->code >= KEY_CNT || ev->value == 2 || debounceWindows[ev->code] == 0)
+        return 0;
+
+    down = (state->down[ev->code / 8] >> (ev->code % 8)) & 1;
+
+    /* Same state as the last accepted transition (chatter leftover), or a press too soon after it (chatter): drop it
+       A release of a key that is down always goes through, or the key would stay down until its next real release */
+    if((ev->value != 0) == down || (ev->value != 0 && debounceInWindow(&state->lastTime[ev->code], &ev->time, debounceWindows[ev->code]))) {
+        ++stats.debounced;
+        return 1;
+    }
+
+    /* Real transition */
+    state->lastTime[ev->code] = ev->time;
+    if(ev->value != 0)
+        state->down[ev->code / 8] |= (unsigned char)(1 << (ev->code % 8));
+    else
+        state->down[ev->code / 8] &= (unsigned char)~(1 << (ev->code % 8));
+
+    return 0;
+}
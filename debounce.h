@@ -0,0 +1,40 @@
+#ifndef BABYBINDS_DEBOUNCE_H
+#define BABYBINDS_DEBOUNCE_H
+
+/***** All stuff related to filtering chattering keys *****/
+/* For datatypes */
+#include "datatypes.h"
+
+/* For the stats */
+#include "globals.h"
+
+/* For input_event and KEY_CNT */
+#include <linux/input.h>
+
+/* Worn switches can chatter, sending press/release/press in a few milliseconds. The debounce filter drops presses of a key
+ * that come sooner than its window after the last accepted transition of that key, using the kernel timestamps of the
+ * events (no timers). Transitions to the state the key already has are dropped too, as they are the leftovers of dropped
+ * chatter. Releases are never dropped otherwise, so a key can't get stuck down (even when a real tap is shorter than the
+ * window): chatter while pressing can at worst turn into a short tap, chatter while releasing is dropped as a whole */
+
+/* Debounce state of a device. O(1) per key: the time of the last accepted transition and whether the key is down */
+struct debounceState {
+    struct timeval lastTime[KEY_CNT];
+    unsigned char down[KEY_CNT / 8 + 1];
+};
+
+/* Sets the debounce window (in milliseconds) of all keys. 0 disables debouncing */
+void debounceSetWindow(long windowMs);
+
+/* Sets the debounce window (in milliseconds) of a single key, overriding the window of all keys
+   Returns 1 on success, 0 if the keycode is not valid */
+int debounceSetKeyWindow(int keycode, long windowMs);
+
+/* Resets the state of a device (all keys up) */
+void debounceReset(struct debounceState* state);
+
+/* Checks if a key event is chatter. Returns 1 if it must be dropped (and counts it in the stats), 0 if not
+   Non-key events and autorepeats are never dropped */
+int debounceFilter(struct debounceState* state, const struct input_event* ev);
+
+#endif
@@ -0,0 +1,301 @@
+/***** device.h implementation *****/
+/* Needed for O_CLOEXEC and CLOCK_MONOTONIC */
+#define _GNU_SOURCE
+
+#include "device.h"
+
+/* For errno */
+#include <errno.h>
+#include <string.h>
+
+/* For opening and closing devices */
+#include <fcntl.h>
+#include <unistd.h>
+
+/* For dropping the binds of removed devices */
+#include "config.h"
+
+/* For not reading removed devices anymore */
+#include "eventloop.h"
+
+/* For switching the clock of event timestamps */
+#include <sys/ioctl.h>
+#include <time.h>
+
+/* Opened devices */
+static struct inputDevice devices[BABYBINDS_MAX_DEVICES];
+static size_t devicesN = 0;
+
+/* Views (the merged view first, then device and group views in the order they were created) and their names
+   The merged view has no name, device views are named after their label (or have no name) and group views after their group */
+static struct keyView views[BABYBINDS_MAX_DEVICES * 2 + 1];
+static const char* viewNames[BABYBINDS_MAX_DEVICES * 2 + 1];
+static int viewIsGroup[BABYBINDS_MAX_DEVICES * 2 + 1];
+static size_t viewsN = 0;
+
+/* Clock of the event timestamps of all devices */
+static int deviceClockID = CLOCK_MONOTONIC;
+
+/*** Internal functions ***/
+/* Adds an empty view. There is always room, as there are at most two views per device plus the merged one */
+static struct keyView* deviceNewView(const char* name, int isGroup);
+
+/* Finds the view of a name (a group if isGroup, else a label). Returns NULL if there is none */
+static struct keyView* deviceFindView(const char* name, int isGroup);
+
+/*** Implementations ***/
+static struct keyView* deviceNewView(const char* name, int isGroup) {
+    struct keyView* view = &views[viewsN];
+
+    memset(view, 0, sizeof(struct keyView));
+    view->scope = -1;
+    view->deferredBind = -1;
+    viewNames[viewsN] = name;
+    viewIsGroup[viewsN] = isGroup;
+    ++viewsN;
+
+    return view;
+}
+
+static struct keyView* deviceFindView(const char* name, int isGroup) {
+    size_t n;
+
+    for(n = 1; n < viewsN; ++n) {
+        if(viewIsGroup[n] == isGroup && viewNames[n] != NULL && strcmp(viewNames[n], name) == 0)
+            return &views[n];
+    }
+
+    return NULL;
+}
+
+int deviceAdd(const char* arg) {
+    struct inputDevice* device;
+    const char* path;
+    const char* equals;
+    char* names;
+
+    if(devicesN == BABYBINDS_MAX_DEVICES) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Too many input devices, ignoring: ", (char*)arg);
+        return 0;
+    }
+
+    /* The merged view is always there */
+    if(viewsN == 0)
+        deviceNewView(NULL, 0);
+
+    device = &devices[devicesN];
+    memset(device, 0, sizeof(struct inputDevice));
+
+    /* Split the label and group from the path. Names can't have slashes, so an = in a path is not mistaken for one */
+    path = arg;
+    names = NULL;
+    equals = strchr(arg, '=');
+    if(equals != NULL && memchr(arg, '/', (size_t)(equals - arg)) == NULL) {
+        char* comma;
+
+        path = equals + 1;
+        names = salloc(NULL, (size_t)(equals - arg) + 1);
+        if(salloc_f())
+            return 0;
+
+        memcpy(names, arg, (size_t)(equals - arg));
+        names[equals - arg] = '\0';
+
+        device->label = names;
+        comma = strchr(names, ',');
+        if(comma != NULL) {
+            *comma = '\0';
+            device->group = comma + 1;
+        }
+
+        if(device->label[0] == '\0' || (device->group != NULL && device->group[0] == '\0')
+            || (device->group != NULL && strchr(device->group, ',') != NULL)) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Invalid input device label or group (expected [<label>[,<group>]=]<path>): ", (char*)arg);
+            sfree(names);
+            return 0;
+        }
+
+        /* Binds are scoped by name, so a name can't be both a label and a group (they would trigger twice) */
+        if(deviceFindView(device->label, 1) != NULL || (device->group != NULL && (deviceFindView(device->group, 0) != NULL
+            || strcmp(device->group, device->label) == 0))) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Input device label and group names must be different: ", (char*)arg);
+            sfree(names);
+            return 0;
+        }
+    }
+
+    device->path = path;
+    device->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(device->fd <= -1) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not open input device: ", strerror(errno));
+        if(names != NULL)
+            sfree(names);
+        return 0;
+    }
+
+    /* Monotonic timestamps can be compared with the current time without wall clock jumps getting in the way
+       Devices that can't switch (not evdev, or old kernels) make all devices go back to the default real-time clock */
+    if(deviceClockID == CLOCK_MONOTONIC && ioctl(device->fd, EVIOCSCLOCKID, &deviceClockID) < 0) {
+        size_t n;
+
+        deviceClockID = CLOCK_REALTIME;
+        for(n = 0; n < devicesN; ++n)
+            ioctl(devices[n].fd, EVIOCSCLOCKID, &deviceClockID);
+    }
+
+    /* Views of this device */
+    device->views[0] = deviceNewView(device->label, 0);
+    device->views[1] = NULL;
+    if(device->group != NULL) {
+        device->views[1] = deviceFindView(device->group, 1);
+        if(device->views[1] == NULL)
+            device->views[1] = deviceNewView(device->group, 1);
+    }
+    device->views[2] = &views[0];
+
+    ++devicesN;
+    return 1;
+}
+
+size_t deviceCount(void) {
+    return devicesN;
+}
+
+struct inputDevice* deviceGet(size_t index) {
+    return &devices[index];
+}
+
+const char* deviceName(size_t index) {
+    return devices[index].label != NULL ? devices[index].label : devices[index].path;
+}
+
+size_t deviceViewCount(void) {
+    return viewsN;
+}
+
+struct keyView* deviceGetView(size_t index) {
+    return &views[index];
+}
+
+int deviceHasName(const char* name) {
+    size_t n;
+
+    for(n = 0; n < devicesN; ++n) {
+        if(devices[n].fd > -1 && ((devices[n].label != NULL && strcmp(devices[n].label, name) == 0)
+            || (devices[n].group != NULL && strcmp(devices[n].group, name) == 0)))
+            return 1;
+    }
+
+    return 0;
+}
+
+size_t deviceAttached(void) {
+    size_t n;
+    size_t attached = 0;
+
+    for(n = 0; n < devicesN; ++n) {
+        if(devices[n].fd > -1)
+            ++attached;
+    }
+
+    return attached;
+}
+
+void deviceRemove(size_t index) {
+    struct inputDevice* device = &devices[index];
+    size_t v;
+
+    loopRemove(device->fd);
+    close(device->fd);
+    device->fd = -1;
+    memset(device->down, 0, sizeof(device->down));
+
+    /* Drop the binds of its label and group if no other attached device has that name */
+    for(v = 0; v < 2; ++v) {
+        const char* name = (v == 0) ? device->label : device->group;
+        const long scope = (device->views[v] != NULL) ? device->views[v]->scope : -1;
+        size_t n;
+
+        if(scope < 0 || deviceHasName(name))
+            continue;
+
+        dropScope((size_t)scope);
+
+        /* Views of the scope (this device's and those of devices removed before) are not matched anymore */
+        for(n = 0; n < viewsN; ++n) {
+            if(views[n].scope == scope) {
+                views[n].scope = -1;
+                views[n].deferredBind = -1;
+            }
+        }
+    }
+}
+
+int deviceClock(void) {
+    return deviceClockID;
+}
+
+void deviceSetClock(int clockID) {
+    deviceClockID = clockID;
+}
+
+void devicePressed(unsigned char* pressed, size_t size) {
+    size_t n;
+    size_t i;
+
+    memset(pressed, 0, size);
+    if(size > sizeof(devices[0].down))
+        size = sizeof(devices[0].down);
+
+    for(n = 0; n < devicesN; ++n) {
+        for(i = 0; i < size; ++i)
+            pressed[i] |= devices[n].down[i];
+    }
+}
+
+void deviceResolveScopes(void) {
+    size_t n;
+    size_t s;
+
+    /* Unscoped binds are matched against the merged view */
+    if(viewsN > 0)
+        views[0].scope = 0;
+
+    for(n = 1; n < viewsN; ++n) {
+        views[n].scope = -1;
+        if(viewNames[n] == NULL)
+            continue;
+
+        for(s = 0; s < scopeNum; ++s) {
+            if(strcmp(scopeNames[s], viewNames[n]) == 0) {
+                views[n].scope = (long)s + 1;
+                break;
+            }
+        }
+    }
+
+    /* A scope without devices is probably a typo or a device that wasn't passed */
+    for(s = 0; s < scopeNum; ++s) {
+        for(n = 1; n < viewsN; ++n) {
+            if(views[n].scope == (long)s + 1)
+                break;
+        }
+
+        if(n == viewsN)
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "No input device has this label or group, its binds will never trigger: ", scopeNames[s]);
+    }
+}
+
+void deviceShutdown(void) {
+    size_t n;
+
+    for(n = 0; n < devicesN; ++n) {
+        if(devices[n].fd > -1)
+            close(devices[n].fd);
+        if(devices[n].label != NULL)
+            sfree(devices[n].label); /* The group is in the same allocation */
+    }
+
+    devicesN = 0;
+    viewsN = 0;
+}
@@ -0,0 +1,110 @@
+#ifndef BABYBINDS_DEVICE_H
+#define BABYBINDS_DEVICE_H
+
+/***** All stuff related to input devices and the key state they are matched against *****/
+/* For datatypes */
+#include "datatypes.h"
+
+/* For bind scopes and compile time settings */
+#include "globals.h"
+
+/* For memory management */
+#include "memory.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* For the debounce state of each device */
+#include "debounce.h"
+
+/* For input_event, KEY_CNT and struct timeval */
+#include <linux/input.h>
+
+/* Several devices can be opened, each with an optional label and group: [<label>[,<group>]=]<path>
+ * Key state is tracked in views, each holding the keys held in it and matched against the binds of one scope:
+ * - Every device has its own view, matched against the binds scoped to its label ([label] in the config)
+ * - Every group has a view merging its devices, matched against the binds scoped to the group name
+ * - A merged view of all devices is matched against unscoped binds, so chords can span devices (a pedal plus a key)
+ * A key event updates only the views of its device, so matching stays O(combo size) per view */
+
+/* Key state matched against the binds of one scope */
+struct keyView {
+    /* Bind scope (see keyCombo.scope), or -1 if no bind uses this view (it is skipped then) */
+    long scope;
+    /* Held keys, ordered from smallest to biggest like bind keycodes */
+    int comboBuffer[BABYBINDS_COMBOBUFFER_SIZE];
+    size_t comboBufferN;
+    /* Key presses since the buffer was last empty (single-key binds only trigger if it is 1) */
+    size_t sessionKeys;
+    /* How many devices of this view hold each key, so that a key held on two devices is only released when both release it */
+    unsigned char refs[KEY_CNT];
+    /* Deferred bind (and the event that matched it, its device index and when the overlap window ends, on CLOCK_MONOTONIC),
+       -1 if none (see doBind) */
+    long deferredBind;
+    struct input_event deferredBindEvent;
+    size_t deferredBindDevice;
+    struct timeval deferredBindDeadline;
+};
+
+/* An opened input device */
+struct inputDevice {
+    /* File descriptor, -1 once the device is removed */
+    int fd;
+    /* Path from the argument */
+    const char* path;
+    /* Label and group from the argument, NULL if not given */
+    char* label;
+    char* group;
+    /* Views updated by this device's events, in this order: its own, its group's and the merged view. The group's is NULL without group */
+    struct keyView* views[3];
+    /* Keys held on this device, so that a repeated press or a stray release doesn't unbalance the merged views */
+    unsigned char down[KEY_CNT / 8 + 1];
+    /* Chatter filter state */
+    struct debounceState debounce;
+    /* Read fail counter */
+    unsigned char failNum;
+    /* Read buffer */
+    struct input_event events[BABYBINDS_EVENT_BATCH];
+};
+
+/* Opens an input device from an argument ([<label>[,<group>]=]<path>). Labels and groups can't have slashes
+   Returns 1 on success, 0 on failure (prints an error message) */
+int deviceAdd(const char* arg);
+
+/* Number of opened devices and a device by index (also its event loop index) */
+size_t deviceCount(void);
+struct inputDevice* deviceGet(size_t index);
+
+/* Name of a device by index, for messages and templates: its label, or its path if it has no label */
+const char* deviceName(size_t index);
+
+/* Number of views and a view by index (for flushing the deferred binds of all views) */
+size_t deviceViewCount(void);
+struct keyView* deviceGetView(size_t index);
+
+/* Returns 1 if an attached device has this label or group, 0 if not */
+int deviceHasName(const char* name);
+
+/* Number of devices that weren't removed */
+size_t deviceAttached(void);
+
+/* Stops reading a removed device (unplugged) and closes it. Its held keys must already be removed from its views
+   The binds of its label and group are dropped (see dropScope) unless another attached device still has them */
+void deviceRemove(size_t index);
+
+/* Clock of the event timestamps of all devices: CLOCK_MONOTONIC, or CLOCK_REALTIME if a device couldn't switch to it */
+int deviceClock(void);
+
+/* Uses the timestamp clock of another process's devices (executors get their events from a reader, see serve.h) */
+void deviceSetClock(int clockID);
+
+/* Fills a bit array (bit n % 8 of byte n / 8 is keycode n) with the keys held on any device */
+void devicePressed(unsigned char* pressed, size_t size);
+
+/* Gives every view the scope of its label or group, once the config is loaded. Warns about scopes no device has */
+void deviceResolveScopes(void);
+
+/* Closes all devices and frees their names */
+void deviceShutdown(void);
+
+#endif
@@ -0,0 +1,467 @@
+/***** eventloop.h implementation *****/
+/* Needed for syscall, MAP_POPULATE and accept4 */
+#define _GNU_SOURCE
+
+#include "eventloop.h"
+
+/* For the io_uring opcode probe */
+#include "memory.h"
+
+/* For errno */
+#include <errno.h>
+#include <string.h>
+
+/* For read, close and syscall */
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* For epoll */
+#include <sys/epoll.h>
+
+/* For accepting connections on listeners */
+#include <sys/socket.h>
+
+/* For io_uring (used through raw syscalls, no liburing needed) */
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+
+/* user_data of io_uring cancel requests, so that their own completions are ignored */
+#define LOOP_CANCEL_DATA ((__u64)BABYBINDS_LOOP_SLOTS)
+
+/* Number of io_uring submission queue entries. Each slot has at most a read and a cancel request in flight */
+#define LOOP_URING_ENTRIES (BABYBINDS_LOOP_SLOTS * 2)
+
+/* Number of opcodes asked about when probing io_uring (the kernel only fills in the ones it knows) */
+#define LOOP_URING_PROBE_OPS 256
+
+/* A watched file descriptor */
+struct loopSlot {
+    /* File descriptor, or -1 if the slot is free */
+    int fd;
+    /* Identification for completions */
+    enum loopKind kind;
+    size_t index;
+    /* Read buffer, NULL for listeners (accepted instead of read) */
+    void* buf;
+    size_t bufSize;
+    /* io_uring only: 1 if a read is in flight */
+    int posted;
+    /* io_uring only: 1 if the slot was removed but its read is still in flight (slot is freed on its completion) */
+    int removed;
+};
+
+/* Backend in use */
+static enum loopBackend loopBackendInUse = LB_epoll;
+
+/* Watched file descriptors */
+static struct loopSlot loopSlots[BABYBINDS_LOOP_SLOTS];
+
+/* epoll file descriptor */
+static int loopEpollFD = -1;
+
+/* io_uring file descriptor, mappings and pointers to the ring fields */
+static int loopUringFD = -1;
+static void* loopSqRing = MAP_FAILED;
+static size_t loopSqRingSize = 0;
+static void* loopCqRing = MAP_FAILED;
+static size_t loopCqRingSize = 0;
+static struct io_uring_sqe* loopSqes = MAP_FAILED;
+static size_t loopSqesSize = 0;
+static unsigned* loopSqTail;
+static unsigned* loopSqMask;
+static unsigned* loopSqArray;
+static unsigned* loopCqHead;
+static unsigned* loopCqTail;
+static unsigned* loopCqMask;
+static struct io_uring_cqe* loopCqes;
+/* Submission queue entries filled but not yet submitted */
+static unsigned loopToSubmit = 0;
+
+/*** Internal functions ***/
+/* Sets up io_uring. Returns 1 on success, 0 on failure (and frees whatever was set up) */
+static int loopUringInit(void);
+
+/* Checks that the kernel supports every io_uring opcode the loop posts (older kernels have io_uring without them, and every
+   request would fail). Returns 1 if it does, 0 if not (errno is set) */
+static int loopUringProbe(void);
+
+/* Frees io_uring resources */
+static void loopUringShutdown(void);
+
+/* Gets the next free submission queue entry, cleared (there is always one, see LOOP_URING_ENTRIES) */
+static struct io_uring_sqe* loopUringGetSqe(void);
+
+/* Waits for io_uring completions */
+static size_t loopUringWait(struct loopCompletion* completions, size_t max);
+
+/* Waits for epoll readiness and reads the ready file descriptors */
+static size_t loopEpollWait(struct loopCompletion* completions, size_t max);
+
+/*** Implementations ***/
+static int loopUringInit(void) {
+#ifdef __NR_io_uring_setup
+    struct io_uring_params params;
+
+    memset(&params, 0, sizeof(params));
+    loopUringFD = (int)syscall(__NR_io_uring_setup, LOOP_URING_ENTRIES, &params);
+    if(loopUringFD < 0) {
+        loopUringFD = -1;
+        return 0;
+    }
+
+    /* Map the rings. With IORING_FEAT_SINGLE_MMAP both rings share the same mapping */
+    loopSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    loopCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        if(loopCqRingSize > loopSqRingSize)
+            loopSqRingSize = loopCqRingSize;
+        loopCqRingSize = 0;
+    }
+
+    loopSqRing = mmap(NULL, loopSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, loopUringFD, IORING_OFF_SQ_RING);
+    if(loopSqRing == MAP_FAILED) {
+        loopUringShutdown();
+        return 0;
+    }
+
+    if(loopCqRingSize == 0)
+        loopCqRing = loopSqRing;
+    else {
+        loopCqRing = mmap(NULL, loopCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, loopUringFD, IORING_OFF_CQ_RING);
+        if(loopCqRing == MAP_FAILED) {
+            loopUringShutdown();
+            return 0;
+        }
+    }
+
+    loopSqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    loopSqes = mmap(NULL, loopSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, loopUringFD, IORING_OFF_SQES);
+    if(loopSqes == MAP_FAILED) {
+        loopUringShutdown();
+        return 0;
+    }
+
+    /* Get pointers to ring fields */
+    loopSqTail  = (unsigned*)((char*)loopSqRing + params.sq_off.tail);
+    loopSqMask  = (unsigned*)((char*)loopSqRing + params.sq_off.ring_mask);
+    loopSqArray = (unsigned*)((char*)loopSqRing + params.sq_off.array);
+    loopCqHead  = (unsigned*)((char*)loopCqRing + params.cq_off.head);
+    loopCqTail  = (unsigned*)((char*)loopCqRing + params.cq_off.tail);
+    loopCqMask  = (unsigned*)((char*)loopCqRing + params.cq_off.ring_mask);
+    loopCqes    = (struct io_uring_cqe*)((char*)loopCqRing + params.cq_off.cqes);
+
+    if(!loopUringProbe()) {
+        loopUringShutdown();
+        return 0;
+    }
+
+    return 1;
+#else
+    /* Built against headers without io_uring syscalls */
+    return 0;
+#endif
+}
+
+static int loopUringProbe(void) {
+#if defined(__NR_io_uring_register) && defined(IO_URING_OP_SUPPORTED)
+    const size_t size = sizeof(struct io_uring_probe) + LOOP_URING_PROBE_OPS * sizeof(struct io_uring_probe_op);
+    static const int needed[] = { IORING_OP_READ, IORING_OP_ACCEPT, IORING_OP_ASYNC_CANCEL };
+    struct io_uring_probe* probe;
+    size_t n;
+    int supported = 1;
+
+    probe = salloc(NULL, size);
+    if(salloc_f())
+        return 0; /* Out of memory! */
+    memset(probe, 0, size);
+
+    /* Kernels too old to probe (before 5.6) are also too old to read */
+    if(syscall(__NR_io_uring_register, loopUringFD, IORING_REGISTER_PROBE, probe, LOOP_URING_PROBE_OPS) < 0) {
+        sfree(probe);
+        return 0;
+    }
+
+    for(n = 0; n < sizeof(needed) / sizeof(needed[0]); ++n) {
+        if(needed[n] >= probe->ops_len || !(probe->ops[needed[n]].flags & IO_URING_OP_SUPPORTED))
+            supported = 0;
+    }
+
+    sfree(probe);
+    if(!supported)
+        errno = EOPNOTSUPP;
+    return supported;
+#else
+    /* Built against headers without the probe: assume the opcodes aren't there either */
+    errno = ENOSYS;
+    return 0;
+#endif
+}
+
+static void loopUringShutdown(void) {
+    if(loopSqes != MAP_FAILED)
+        munmap(loopSqes, loopSqesSize);
+    if(loopCqRing != MAP_FAILED && loopCqRing != loopSqRing)
+        munmap(loopCqRing, loopCqRingSize);
+    if(loopSqRing != MAP_FAILED)
+        munmap(loopSqRing, loopSqRingSize);
+    if(loopUringFD > -1)
+        close(loopUringFD);
+
+    loopSqes = MAP_FAILED;
+    loopCqRing = MAP_FAILED;
+    loopSqRing = MAP_FAILED;
+    loopUringFD = -1;
+}
+
+static struct io_uring_sqe* loopUringGetSqe(void) {
+    /* Only this process writes the tail, so no atomic load is needed */
+    const unsigned tail = *loopSqTail;
+    const unsigned i = tail & *loopSqMask;
+    struct io_uring_sqe* sqe = &loopSqes[i];
+
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    loopSqArray[i] = i;
+
+    /* Publish entry. The kernel only reads it on the next io_uring_enter, but the release is needed for SQPOLL-like setups anyway */
+    __atomic_store_n(loopSqTail, tail + 1, __ATOMIC_RELEASE);
+    ++loopToSubmit;
+
+    return sqe;
+}
+
+static size_t loopUringWait(struct loopCompletion* completions, size_t max) {
+    size_t n;
+    size_t completionsN;
+    unsigned head;
+    unsigned tail;
+
+    /* Re-post reads for all slots without one in flight (new slots and slots returned by the last loopWait) */
+    for(n = 0; n < BABYBINDS_LOOP_SLOTS; ++n) {
+        struct loopSlot* slot = &loopSlots[n];
+
+        if(slot->fd > -1 && !slot->posted && !slot->removed) {
+            struct io_uring_sqe* sqe = loopUringGetSqe();
+
+            if(slot->buf == NULL) {
+                /* Listener: accept a connection (no peer address needed) */
+                sqe->opcode = IORING_OP_ACCEPT;
+                sqe->fd = slot->fd;
+                sqe->accept_flags = SOCK_CLOEXEC;
+            }
+            else {
+                sqe->opcode = IORING_OP_READ;
+                sqe->fd = slot->fd;
+                sqe->addr = (__u64)(unsigned long)slot->buf;
+                sqe->len = (__u32)slot->bufSize;
+                sqe->off = (__u64)-1; /* Current position (these are all non-seekable anyway) */
+            }
+            sqe->user_data = (__u64)n;
+            slot->posted = 1;
+        }
+    }
+
+    /* Submit and wait in a single syscall. Don't wait if there are completions left over from last time */
+    head = *loopCqHead;
+    tail = __atomic_load_n(loopCqTail, __ATOMIC_ACQUIRE);
+    if(loopToSubmit > 0 || head == tail) {
+        const unsigned minComplete = (head == tail) ? 1 : 0;
+        long submitted;
+
+        submitted = syscall(__NR_io_uring_enter, loopUringFD, loopToSubmit, minComplete, minComplete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if(submitted < 0) {
+            if(errno != EINTR)
+                taggedMsg2(TM_warning | TM_flush | TM_newline, "io_uring_enter failed: ", strerror(errno));
+            return 0;
+        }
+        loopToSubmit -= (unsigned)submitted;
+
+        tail = __atomic_load_n(loopCqTail, __ATOMIC_ACQUIRE);
+    }
+
+    /* Reap completions */
+    completionsN = 0;
+    while(head != tail && completionsN < max) {
+        const struct io_uring_cqe* cqe = &loopCqes[head & *loopCqMask];
+        ++head;
+
+        if(cqe->user_data < LOOP_CANCEL_DATA) {
+            struct loopSlot* slot = &loopSlots[cqe->user_data];
+
+            slot->posted = 0;
+            if(slot->removed) {
+                /* Removed while in flight: the slot can finally be freed */
+                slot->removed = 0;
+                slot->fd = -1;
+            }
+            else {
+                completions[completionsN].kind = slot->kind;
+                completions[completionsN].index = slot->index;
+                completions[completionsN].buf = slot->buf;
+                completions[completionsN].result = cqe->res;
+                ++completionsN;
+            }
+        }
+    }
+
+    __atomic_store_n(loopCqHead, head, __ATOMIC_RELEASE);
+
+    return completionsN;
+}
+
+static size_t loopEpollWait(struct loopCompletion* completions, size_t max) {
+    struct epoll_event events[BABYBINDS_LOOP_SLOTS];
+    int eventsN;
+    int n;
+    size_t completionsN;
+
+    if(max > BABYBINDS_LOOP_SLOTS)
+        max = BABYBINDS_LOOP_SLOTS;
+
+    eventsN = epoll_wait(loopEpollFD, events, (int)max, -1);
+    if(eventsN < 0) {
+        if(errno != EINTR)
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "epoll_wait failed: ", strerror(errno));
+        return 0;
+    }
+
+    /* Read every ready file descriptor once */
+    completionsN = 0;
+    for(n = 0; n < eventsN; ++n) {
+        struct loopSlot* slot = &loopSlots[events[n].data.u32];
+        ssize_t result;
+
+        if(slot->fd < 0)
+            continue;
+
+        if(slot->buf == NULL)
+            result = accept4(slot->fd, NULL, NULL, SOCK_CLOEXEC);
+        else
+            result = read(slot->fd, slot->buf, slot->bufSize);
+        if(result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            continue; /* Spurious wake-up on a non-blocking file descriptor */
+
+        completions[completionsN].kind = slot->kind;
+        completions[completionsN].index = slot->index;
+        completions[completionsN].buf = slot->buf;
+        completions[completionsN].result = (result < 0) ? -errno : (long)result;
+        ++completionsN;
+    }
+
+    return completionsN;
+}
+
+int loopInit(enum loopBackend backend) {
+    size_t n;
+
+    for(n = 0; n < BABYBINDS_LOOP_SLOTS; ++n) {
+        loopSlots[n].fd = -1;
+        loopSlots[n].posted = 0;
+        loopSlots[n].removed = 0;
+    }
+
+    if(backend == LB_uring) {
+        if(loopUringInit()) {
+            loopBackendInUse = LB_uring;
+            return 1;
+        }
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "io_uring not available, falling back to epoll: ", strerror(errno));
+    }
+
+    loopBackendInUse = LB_epoll;
+    loopEpollFD = epoll_create1(EPOLL_CLOEXEC);
+    if(loopEpollFD < 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not create epoll instance: ", strerror(errno));
+        return 0;
+    }
+
+    return 1;
+}
+
+enum loopBackend loopGetBackend(void) {
+    return loopBackendInUse;
+}
+
+int loopAdd(int fd, enum loopKind kind, size_t index, void* buf, size_t bufSize) {
+    size_t n;
+
+    /* Find a free slot (removed slots still in flight are not free yet) */
+    for(n = 0; n < BABYBINDS_LOOP_SLOTS; ++n) {
+        if(loopSlots[n].fd < 0 && !loopSlots[n].removed)
+            break;
+    }
+
+    if(n == BABYBINDS_LOOP_SLOTS) {
+        taggedMsg(TM_warning | TM_flush | TM_newline, "Too many file descriptors in the event loop!");
+        return 0;
+    }
+
+    if(loopBackendInUse == LB_epoll) {
+        struct epoll_event event;
+
+        event.events = EPOLLIN;
+        event.data.u64 = 0;
+        event.data.u32 = (unsigned)n;
+        if(epoll_ctl(loopEpollFD, EPOLL_CTL_ADD, fd, &event) == -1) {
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not add file descriptor to epoll: ", strerror(errno));
+            return 0;
+        }
+    }
+
+    /* With io_uring, the read is posted on the next loopWait */
+    loopSlots[n].fd = fd;
+    loopSlots[n].kind = kind;
+    loopSlots[n].index = index;
+    loopSlots[n].buf = buf;
+    loopSlots[n].bufSize = bufSize;
+    loopSlots[n].posted = 0;
+
+    return 1;
+}
+
+int loopAddListener(int fd, enum loopKind kind, size_t index) {
+    return loopAdd(fd, kind, index, NULL, 0);
+}
+
+void loopRemove(int fd) {
+    size_t n;
+
+    for(n = 0; n < BABYBINDS_LOOP_SLOTS; ++n) {
+        struct loopSlot* slot = &loopSlots[n];
+
+        if(slot->fd != fd || slot->removed)
+            continue;
+
+        if(loopBackendInUse == LB_epoll) {
+            epoll_ctl(loopEpollFD, EPOLL_CTL_DEL, fd, NULL);
+            slot->fd = -1;
+        }
+        else if(slot->posted) {
+            /* Cancel the read in flight. The kernel holds its own reference to the file, so closing it right after is fine */
+            struct io_uring_sqe* sqe = loopUringGetSqe();
+
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->addr = (__u64)n;
+            sqe->user_data = LOOP_CANCEL_DATA;
+            slot->removed = 1;
+        }
+        else
+            slot->fd = -1;
+
+        return;
+    }
+}
+
+size_t loopWait(struct loopCompletion* completions, size_t max) {
+    if(loopBackendInUse == LB_uring)
+        return loopUringWait(completions, max);
+    else
+        return loopEpollWait(completions, max);
+}
+
+void loopShutdown(void) {
+    if(loopEpollFD > -1)
+        close(loopEpollFD);
+    loopEpollFD = -1;
+
+    loopUringShutdown();
+}
@@ -0,0 +1,47 @@
+#ifndef BABYBINDS_EVENTLOOP_H
+#define BABYBINDS_EVENTLOOP_H
+
+/***** All stuff related to waiting for and reading from file descriptors *****/
+/* For datatypes */
+#include "datatypes.h"
+
+/* For compile time settings */
+#include "globals.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* The event loop has a completion-based interface for both backends:
+ * - Every added file descriptor always has a read "posted" into its buffer
+ * - loopWait blocks until at least one of these reads finishes and returns them
+ * - The data in a returned buffer is valid until the next loopWait, which re-posts the read
+ * With epoll, the reads are done by loopWait itself after waiting. With io_uring, the kernel does them asynchronously
+ * and results for any number of file descriptors are reaped (and reads re-posted) in a single syscall */
+
+/* Initializes the event loop with a backend. If io_uring is wanted but not available, epoll is used instead
+   Returns 1 on success, 0 on failure */
+int loopInit(enum loopBackend backend);
+
+/* Returns the backend actually in use (can differ from the one passed to loopInit because of the fallback) */
+enum loopBackend loopGetBackend(void);
+
+/* Starts watching a file descriptor, reading up to bufSize bytes into buf each time it has data
+   Kind and index identify the file descriptor in completions. Returns 1 on success, 0 on failure (buf can't be NULL, see loopAddListener) */
+int loopAdd(int fd, enum loopKind kind, size_t index, void* buf, size_t bufSize);
+
+/* Starts watching a listening socket, accepting a connection each time there is one (instead of reading)
+   The result of its completions is the accepted file descriptor (close-on-exec) or -errno. Returns 1 on success, 0 on failure */
+int loopAddListener(int fd, enum loopKind kind, size_t index);
+
+/* Stops watching a file descriptor. The file descriptor can be closed right after this
+   Does nothing if the file descriptor is not being watched */
+void loopRemove(int fd);
+
+/* Waits for reads to finish and stores up to max of them in completions
+   Returns the number of completions stored (0 only if interrupted) */
+size_t loopWait(struct loopCompletion* completions, size_t max);
+
+/* Frees all event loop resources. Watched file descriptors are not closed */
+void loopShutdown(void);
+
+#endif
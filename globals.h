@@ -4,16 +4,114 @@
 /* For datatypes */
 #include "datatypes.h"
 
+/* For KEY_CNT */
+#include <linux/input.h>
+
 /***** Compile time settings *****/
 #ifndef BABYBINDS_COMBOBUFFER_SIZE
     #define BABYBINDS_COMBOBUFFER_SIZE 5
 #endif
 
-/***** Global variables *****/
-/* These need to be global so that they are accessible within shutdownDaemon(), main.c, etc
-   File descriptor for input device */
-int devFD;
+/* Bytes of stack pre-faulted by the low-latency mode */
+#ifndef BABYBINDS_PREFAULT_STACK
+    #define BABYBINDS_PREFAULT_STACK 65536
+#endif
+
+/* Maximum number of input devices */
+#ifndef BABYBINDS_MAX_DEVICES
+    #define BABYBINDS_MAX_DEVICES 8
+#endif
+
+/* Maximum depth of config includes (deeper ones are taken for include loops) */
+#ifndef BABYBINDS_INCLUDE_DEPTH
+    #define BABYBINDS_INCLUDE_DEPTH 16
+#endif
+
+/* Maximum number of executors connected to a reader (see serve.h) */
+#ifndef BABYBINDS_SERVE_CLIENTS
+    #define BABYBINDS_SERVE_CLIENTS 16
+#endif
 
+/* Maximum number of executors of the same user connected to a reader */
+#ifndef BABYBINDS_SERVE_USER_CLIENTS
+    #define BABYBINDS_SERVE_USER_CLIENTS 4
+#endif
+
+/* Seconds an executor has to finish its registration before the reader disconnects it */
+#ifndef BABYBINDS_SERVE_DEADLINE
+    #define BABYBINDS_SERVE_DEADLINE 5
+#endif
+
+/* Maximum number of binds an executor can register */
+#ifndef BABYBINDS_SERVE_BINDS
+    #define BABYBINDS_SERVE_BINDS 1024
+#endif
+
+/* Maximum number of binds of all executors together, and of scope names they can add. They bound the bind tables of a reader
+   and the time indexing them takes whenever an executor comes or goes (which is done between events) */
+#ifndef BABYBINDS_SERVE_TOTAL_BINDS
+    #define BABYBINDS_SERVE_TOTAL_BINDS 4096
+#endif
+#ifndef BABYBINDS_SERVE_SCOPES
+    #define BABYBINDS_SERVE_SCOPES 256
+#endif
+
+/* Size of device and scope names sent between a reader and its executors (with the null terminator, longer ones are cut) */
+#ifndef BABYBINDS_SERVE_NAME
+    #define BABYBINDS_SERVE_NAME 64
+#endif
+
+/* Maximum number of file descriptors watched by the event loop */
+#ifndef BABYBINDS_LOOP_SLOTS
+    #define BABYBINDS_LOOP_SLOTS 64
+#endif
+
+/* Maximum number of input_event structs read from a device at once */
+#ifndef BABYBINDS_EVENT_BATCH
+    #define BABYBINDS_EVENT_BATCH 64
+#endif
+
+/* Maximum number of children with captured output at the same time */
+#ifndef BABYBINDS_CAPTURE_SLOTS
+    #define BABYBINDS_CAPTURE_SLOTS 16
+#endif
+
+/* Size of the read buffer of each captured stream */
+#ifndef BABYBINDS_CAPTURE_READ
+    #define BABYBINDS_CAPTURE_READ 512
+#endif
+
+/* Maximum length of a captured line. Longer lines are split */
+#ifndef BABYBINDS_CAPTURE_LINE
+    #define BABYBINDS_CAPTURE_LINE 256
+#endif
+
+/* Maximum bytes of command output written to the log per event loop wakeup (in a single write). Lines past it are dropped */
+#ifndef BABYBINDS_CAPTURE_FLUSH
+    #define BABYBINDS_CAPTURE_FLUSH 16384
+#endif
+
+/* Size at which the command output log is rotated */
+#ifndef BABYBINDS_CAPTURE_LOG_SIZE
+    #define BABYBINDS_CAPTURE_LOG_SIZE 1048576
+#endif
+
+/* Default time (in milliseconds) an ambiguous combo waits for a longer combo containing it before triggering */
+#ifndef BABYBINDS_OVERLAP_WINDOW
+    #define BABYBINDS_OVERLAP_WINDOW 100
+#endif
+
+/* Default time (in milliseconds) a plugin entry can run before the watchdog interrupts it */
+#ifndef BABYBINDS_PLUGIN_BUDGET
+    #define BABYBINDS_PLUGIN_BUDGET 20
+#endif
+
+/***** Config hash (32-bit FNV-1a over the raw config file bytes) *****/
+#define BABYBINDS_HASH_INIT 2166136261UL
+#define BABYBINDS_HASH_STEP(hash, byte) ((((hash) ^ (unsigned char)(byte)) * 16777619UL) & 0xFFFFFFFFUL)
+
+/***** Global variables *****/
+/* These need to be global so that they are accessible within shutdownDaemon(), main.c, etc */
 struct keyCombo* comboBinds;
 
 struct keyExec* comboExecs;
@@ -21,4 +119,23 @@ struct keyExec* comboExecs;
 /* The size of comboBinds AND comboExecs */
 size_t bindNum;
 
+/* Index of the binds by keycode (built by indexKeybinds), so keys without binds cost a single load on the event path:
+   - First single-key bind of each keycode plus one, 0 if none. The binds of the keycode in other scopes follow keyCombo.nextSingle
+   - Bit per keycode, set if any combo of two or more keys (of any scope) has it */
+size_t singleBindIndex[KEY_CNT];
+unsigned char comboKeyMap[KEY_CNT / 8 + 1];
+
+/* Names of the bind scopes ([name] in the config), in order of appearance. Scope n is scopeNames[n - 1] (scope 0 is any device) */
+char** scopeNames;
+size_t scopeNum;
+
+/* Hash of the loaded config file (and the files it includes), to check if a compiled matcher was compiled from it */
+unsigned long configHash;
+
+/* Number of profile sections not built because no device has their name (bind numbers differ from a compiled matcher's then) */
+size_t skippedProfiles;
+
+/* What the daemon did so far */
+struct daemonStats stats;
+
 #endif
@@ -0,0 +1,11 @@
+#ifndef BABYBINDS_KEYNAMES_H
+#define BABYBINDS_KEYNAMES_H
+
+/***** Names of keycodes, for printing them *****/
+/* For size_t */
+#include <stdlib.h>
+
+/* Returns the name of a keycode (like "KEY_A" for 30), or NULL if it has none */
+const char* keyName(int keycode);
+
+#endif
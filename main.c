@@ -2,8 +2,29 @@
 /* This header should chain include all neccessary header files */
 #include "config.h"
 
+/* For the low-latency mode */
+#include "realtime.h"
+
+/* For grab mode */
+#include "passthrough.h"
+
+/* For filtering chatter */
+#include "debounce.h"
+
+/* For input devices and their key views */
+#include "device.h"
+
+/* For probe mode */
+#include "probe.h"
+
+/* For reader and executor modes */
+#include "serve.h"
+
+/* For argument parsing */
+#include <getopt.h>
+#include <limits.h>
+
 /* Linux input includes */
-#include <fcntl.h>
 #include <linux/input.h>
 
 /*
@@ -44,94 +65,470 @@
  * - Check the rest of the source (todos scattered all over it :| ) In a nutshell:
  *   - Arguments:
  *     - Daemon mode
- *     - Keycode check mode
- *     - Non-default config file
- *     - Multiple input devices
  *     - Verbose flag (always on for now)
  */
 
 /*** Functions ***/
-/* Inserts a key to the comparison buffer
-   When inserting, an insertion sort is performed for easy keybind comparison (from smallest to biggest) and the new size is updated */
-void insertKey(int* comboBuffer, size_t* comboBufferN, int keycode);
+/* Inserts a key to the comparison buffer of a view
+   When inserting, an insertion sort is performed for easy keybind comparison (from smallest to biggest) and the new size is updated
+   If the key is already held on another device of the view, it is only counted
+   Returns 1 if the key was added to the buffer, 0 if not (already there or buffer full) */
+int insertKey(struct keyView* view, int keycode);
 
-/* Removes a key from the comparison buffer
+/* Removes a key from the comparison buffer of a view, once no device of the view holds it
    Everything is pushed back to line up and the new size is updated. If a key couldn't be removed (not in buffer) do nothing, as it might have been ignored by insertKey */
-void removeKey(int* comboBuffer, size_t* comboBufferN, int keycode);
+void removeKey(struct keyView* view, int keycode);
+
+/* Updates a view with a key press or release, triggering its binds
+   Single-key binds also need the key to be alone in the merged view, so keys of a chord spanning devices never trigger them
+   (the merged view must be updated last, as it is checked before it sees the release)
+   index is the device the event came from, for argument templates
+   Returns 1 if a key press is consumed by a bind of the view (see passthroughEvent), 0 if not */
+int processKey(struct keyView* view, const struct keyView* merged, const struct input_event* ev, size_t index);
+
+/* Parses an input event of a device (by index), updating the views of the device and triggering binds (and passing it through, in grab mode)
+   Chattering key events are dropped before anything else, using the debounce state of the device */
+void processEvent(size_t index, const struct input_event* ev);
+
+/* Removes an unplugged device (by index): its held keys are removed from its views without triggering anything, and the
+   binds of its label and group are dropped if no other device has them (see deviceRemove) */
+void removeDevice(size_t index);
+
+/* Parses a --debounce-key argument (<keycode>=<milliseconds>). Returns 1 on success, 0 on failure (prints an error message) */
+int parseDebounceKeyArg(const char* arg);
+
+/* Parses a non-negative decimal integer argument no bigger than max
+   Returns 1 on success and stores the value in out, or 0 on failure (prints an error message mentioning the option) */
+int parseIntArg(const char* arg, int max, const char* optionName, int* out);
 
 /*** Function implementations ***/
-void insertKey(int* comboBuffer, size_t* comboBufferN, int keycode) {
-    size_t newSize;
+int processKey(struct keyView* view, const struct keyView* merged, const struct input_event* ev, size_t index) {
+    /* 1 if the event is a key press consumed by a bind (not passed through in grab mode) */
+    int consumed = 0;
+
+    if(ev->value == 0) { /* Key released */
+        /* A key release means no longer combo is coming */
+        doDeferredBind(view);
+
+        removeKey(view, ev->code);
+        if(view->comboBufferN == 0) {
+            if(view->sessionKeys == 1 && merged->sessionKeys == 1)
+                doSingleBind((size_t)view->scope, ev, index);
+            view->sessionKeys = 0;
+        }
+    }
+    else { /* Key pressed */
+        ++view->sessionKeys;
+
+        /* A key already held on another device doesn't change the combo, so it can't trigger it again
+           Neither can a key in no combo: combos only need to be looked up when it is in one */
+        if(insertKey(view, ev->code) && view->comboBufferN > 1 && keyInCombo(ev->code))
+            consumed = doBind(view, ev, index);
+
+        /* Keys with a single-key bind are always consumed, as it is only known on release if they trigger */
+        if(!consumed)
+            consumed = keyHasSingleBind((size_t)view->scope, ev->code);
+    }
+
+    return consumed;
+}
+
+void processEvent(size_t index, const struct input_event* ev) {
+    struct inputDevice* device = deviceGet(index);
+    /* 1 if the event is a key press consumed by a bind of any view (not passed through in grab mode) */
+    int consumed = 0;
+
+    ++stats.events;
+
+    /* Drop chatter (it is not passed through either) */
+    if(debounceFilter(&device->debounce, ev))
+        return;
+
+    if(ev->type == EV_KEY && ev->code < KEY_CNT) { /* Input is a key! Continue... */
+        const int down = (device->down[ev->code / 8] >> (ev->code % 8)) & 1;
+        size_t v;
+
+        ++stats.keyEvents;
+
+        /* Notes:
+           - key autorepeats are ignored as we don't need to care about them for key combinations
+           - single-key keybinds are triggered on key release and ONLY IF ALONE (no other key was pressed on any device while it was held)
+           - multi-key keybinds are triggered on key press, or on the next key release or overlap window timeout if ambiguous
+           - key combos are ordered by ev.code value
+           - every view of the device (its own, its group's and the merged one) is matched against the binds of its scope */
+
+        if(ev->value == 1 && down)
+            taggedMsg(TM_info | TM_flush | TM_newline, "Ignoring key (already held on this device)...");
+        else if((ev->value == 1 && !down) || (ev->value == 0 && down)) { /* Key pressed or released */
+            device->down[ev->code / 8] ^= (unsigned char)(1 << (ev->code % 8));
+
+            for(v = 0; v < 3; ++v) {
+                if(device->views[v] != NULL && device->views[v]->scope >= 0)
+                    consumed |= processKey(device->views[v], device->views[2], ev, index);
+            }
+        }
+    }
+
+    passthroughEvent(index, ev, consumed);
+}
+
+void removeDevice(size_t index) {
+    struct inputDevice* device = deviceGet(index);
+    int keycode;
+    size_t v;
+
+    taggedMsg2(TM_warning | TM_flush | TM_newline, "Input device removed: ", (char*)device->path);
+
+    for(keycode = 0; keycode < KEY_CNT; ++keycode) {
+        if(!((device->down[keycode / 8] >> (keycode % 8)) & 1))
+            continue;
+
+        for(v = 0; v < 3; ++v) {
+            if(device->views[v] == NULL)
+                continue;
+
+            removeKey(device->views[v], keycode);
+            if(device->views[v]->comboBufferN == 0)
+                device->views[v]->sessionKeys = 0;
+        }
+    }
+
+    passthroughRemove(index);
+
+    /* Dropping binds frees them. This only happens on unplugging, so the allocator doesn't matter here */
+    sallocUnlock();
+    deviceRemove(index);
+    sallocLock();
+}
+
+int parseDebounceKeyArg(const char* arg) {
+    char* end;
+    long keycode;
+    long windowMs;
+
+    keycode = strtol(arg, &end, 10);
+    if(end != arg && *end == '=') {
+        const char* windowStr = end + 1;
+
+        windowMs = strtol(windowStr, &end, 10);
+        if(end != windowStr && *end == '\0' && windowMs >= 0 && windowMs <= 10000 && debounceSetKeyWindow((int)keycode, windowMs))
+            return 1;
+    }
+
+    taggedMsg2(TM_error | TM_flush | TM_newline, "Invalid value for option --debounce-key (expected <keycode>=<milliseconds>): ", (char*)arg);
+    return 0;
+}
+
+int parseIntArg(const char* arg, int max, const char* optionName, int* out) {
+    char* end;
+    long val;
+
+    errno = 0;
+    val = strtol(arg, &end, 10);
+    if(errno != 0 || end == arg || *end != '\0' || val < 0 || val > max) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Invalid value for option ", (char*)optionName);
+        return 0;
+    }
+
+    *out = (int)val;
+    return 1;
+}
+
+int insertKey(struct keyView* view, int keycode) {
+    /* Held on another device of this view: just count it */
+    if(view->refs[keycode] > 0) {
+        ++view->refs[keycode];
+        return 0;
+    }
 
     /* If the comboBuffer is full, ignore all other key presses */
-    if(*comboBufferN == BABYBINDS_COMBOBUFFER_SIZE) {
+    if(view->comboBufferN == BABYBINDS_COMBOBUFFER_SIZE) {
         taggedMsg(TM_info | TM_flush | TM_newline, "Too many keys at the same time! Ignoring latest key...");
-        return;
+        return 0;
     }
 
     /* Insert using already existing unique ordered array insert function */
-    newSize = intPtrOrderedUniqueInsert(comboBuffer, *comboBufferN, keycode);
-    /* If size remained the same, value was already in the array, so ignore it
-       Note that this probably will never happen unless you have a keyboard with keys with equal keycodes (is there even a keyboard that does this? :S ) */
-    if(newSize == *comboBufferN)
-        taggedMsg(TM_info | TM_flush | TM_newline, "Ignoring key (already in combo buffer)...");
-    else
-        *comboBufferN = newSize;
+    view->comboBufferN = intPtrOrderedUniqueInsert(view->comboBuffer, view->comboBufferN, keycode);
+    view->refs[keycode] = 1;
+    return 1;
 }
 
-void removeKey(int* comboBuffer, size_t* comboBufferN, int keycode) {
-    /* Remove using already existing function */
-    *comboBufferN = intPtrRemove(comboBuffer, *comboBufferN, keycode);
+void removeKey(struct keyView* view, int keycode) {
+    /* Not in the buffer (ignored by insertKey) */
+    if(view->refs[keycode] == 0)
+        return;
+
+    /* Remove using already existing function, once no device holds it */
+    if(--view->refs[keycode] == 0)
+        view->comboBufferN = intPtrRemove(view->comboBuffer, view->comboBufferN, keycode);
 }
 
 /* Main (contains keybind loop) */
 int main(int argc, char* argv[]) {
     /*** Declare variables ***/
-    /* Event */
-    struct input_event ev;
-    /* Error (or success) of read */
-    ssize_t n;
-    /* Key combo buffer */
-    size_t comboBufferN;
-    int comboBuffer[BABYBINDS_COMBOBUFFER_SIZE];
-    /* Read fail counter */
-    unsigned char failNum;
+    /* Event loop completions, iterator and loop flag */
+    struct loopCompletion completions[BABYBINDS_LOOP_SLOTS];
+    size_t completionsN;
+    size_t n;
+    int running;
+    /* Low-latency mode settings (real-time priority and pinned CPU, disabled if 0 or -1 respectively) */
+    int rtPriority;
+    int rtCPU;
+    /* Event loop backend */
+    enum loopBackend backend;
+    /* Command output log path (NULL for default) and discard flag */
+    const char* outputLogPath;
+    int discardOutput;
+    /* Overlap window in milliseconds */
+    int overlapWindow;
+    /* Grab mode flag */
+    int grab;
+    /* Compiled matcher paths (output in compile mode, or the one to load) */
+    const char* compilePath;
+    const char* matcherPath;
+    /* Plugin budget in milliseconds */
+    int pluginBudget;
+    /* Debounce window in milliseconds for all keys (only for parsing, it is stored by the debounce filter) */
+    int debounceWindow;
+    /* Config file path (NULL for default) */
+    const char* configPath;
+    /* Status page path (NULL for default) and flag */
+    const char* statusPath;
+    int status;
+    /* Socket paths of reader and executor modes (NULL if not in that mode) */
+    const char* servePath;
+    const char* executorPath;
+    /* 1 if binds are matched (not in probe and executor modes) and if commands are executed (not in probe and reader modes) */
+    int matches;
+    int executes;
+    /* Argument parsing */
+    int opt;
+    static const struct option longOptions[] = {
+        { "realtime",       required_argument, NULL, 'r' },
+        { "cpu",            required_argument, NULL, 'c' },
+        { "backend",        required_argument, NULL, 'b' },
+        { "output-log",     required_argument, NULL, 'o' },
+        { "discard-output", no_argument,       NULL, 'n' },
+        { "overlap-window", required_argument, NULL, 'w' },
+        { "grab",           no_argument,       NULL, 'g' },
+        { "compile",        required_argument, NULL, 'C' },
+        { "matcher",        required_argument, NULL, 'm' },
+        { "plugin-budget",  required_argument, NULL, 'P' },
+        { "debounce",       required_argument, NULL, 'd' },
+        { "debounce-key",   required_argument, NULL, 'D' },
+        { "status",         required_argument, NULL, 's' },
+        { "no-status",      no_argument,       NULL, 'S' },
+        { "config",         required_argument, NULL, 'f' },
+        { "probe",          no_argument,       NULL, 'p' },
+        { "serve",          required_argument, NULL, 'l' },
+        { "executor",       required_argument, NULL, 'e' },
+        { NULL,       0,                 NULL, 0   }
+    };
 
     /*** Initialize globals ***/
-    devFD = -1;
     comboBinds = NULL;
     comboExecs = NULL;
     bindNum = 0;
+    scopeNames = NULL;
+    scopeNum = 0;
 
     /*** Parse arguments ***/
-    /* TODO: verbose flag (always verbose for now), multiple devs (*), non-default .*rc, combo code check mode, daemon (*) */
-    if(argc > 1) {
-        /* Open the input device */
-        devFD = open(argv[1], O_RDONLY);
-        if(devFD <= -1) {
-            taggedMsg2(TM_error | TM_flush | TM_newline, "Could not open input device: ", strerror(errno));
+    /* TODO: verbose flag (always verbose for now), daemon (*) */
+    rtPriority = 0;
+    rtCPU = -1;
+    backend = LB_epoll;
+    outputLogPath = NULL;
+    discardOutput = 0;
+    overlapWindow = BABYBINDS_OVERLAP_WINDOW;
+    grab = 0;
+    compilePath = NULL;
+    matcherPath = NULL;
+    pluginBudget = BABYBINDS_PLUGIN_BUDGET;
+    statusPath = NULL;
+    status = 1;
+    configPath = NULL;
+    servePath = NULL;
+    executorPath = NULL;
+    while((opt = getopt_long(argc, argv, "r:c:b:o:nw:gC:m:P:d:D:s:Sf:pl:e:", longOptions, NULL)) != -1) {
+        switch(opt) {
+        case 'r':
+            if(!parseIntArg(optarg, 99, "--realtime", &rtPriority))
+                return EXIT_FAILURE;
+            break;
+        case 'c':
+            if(!parseIntArg(optarg, INT_MAX, "--cpu", &rtCPU))
+                return EXIT_FAILURE;
+            break;
+        case 'b':
+            if(strcmp(optarg, "epoll") == 0)
+                backend = LB_epoll;
+            else if(strcmp(optarg, "uring") == 0)
+                backend = LB_uring;
+            else {
+                taggedMsg2(TM_error | TM_flush | TM_newline, "Unknown event loop backend: ", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'o':
+            outputLogPath = optarg;
+            break;
+        case 'n':
+            discardOutput = 1;
+            break;
+        case 'w':
+            if(!parseIntArg(optarg, 10000, "--overlap-window", &overlapWindow))
+                return EXIT_FAILURE;
+            break;
+        case 'g':
+            grab = 1;
+            break;
+        case 'C':
+            compilePath = optarg;
+            break;
+        case 'm':
+            matcherPath = optarg;
+            break;
+        case 'P':
+            if(!parseIntArg(optarg, 10000, "--plugin-budget", &pluginBudget) || pluginBudget == 0) {
+                taggedMsg(TM_error | TM_flush | TM_newline, "The plugin budget must be at least 1 ms");
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'd':
+            if(!parseIntArg(optarg, 10000, "--debounce", &debounceWindow))
+                return EXIT_FAILURE;
+            debounceSetWindow(debounceWindow);
+            break;
+        case 'D':
+            if(!parseDebounceKeyArg(optarg))
+                return EXIT_FAILURE;
+            break;
+        case 's':
+            statusPath = optarg;
+            break;
+        case 'S':
+            status = 0;
+            break;
+        case 'f':
+            configPath = optarg;
+            break;
+        case 'p':
+            probeEnable();
+            break;
+        case 'l':
+            servePath = optarg;
+            break;
+        case 'e':
+            executorPath = optarg;
+            break;
+        default:
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    /* Compile mode: no input device needed, just compile the config and exit */
+    if(compilePath != NULL) {
+        int success;
+
+        loadConfig(configPath);
+        success = compileConfig(compilePath);
+        shutdownDaemon();
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    /* Executor mode: events come from the reader, which owns the input devices */
+    if(executorPath != NULL) {
+        if(optind < argc || servePath != NULL || probeEnabled()) {
+            taggedMsg(TM_error | TM_flush | TM_newline, "Executors don't open input devices, they get their events from a reader");
             return EXIT_FAILURE;
         }
     }
+    else if(optind < argc) {
+        /* Open the input devices */
+        for(; optind < argc; ++optind) {
+            if(!deviceAdd(argv[optind])) {
+                deviceShutdown();
+                return EXIT_FAILURE;
+            }
+        }
+    }
     else {
         taggedMsg(TM_error | TM_flush | TM_newline, "No input devices passed!");
         printUsage(argv[0]);
         return EXIT_FAILURE;
     }
 
-    /*** Initialize variables ***/
-    /* Prepare comboBuffer */
-    comboBufferN = 0;
-
-    /* Prepare other stuff */
-    failNum = 0;
-    
     /*** Load config ***/
-    loadConfig();
+    /* Probe mode triggers nothing, so it needs no config, no command output and no grab (keys must still reach everything else) */
+    if(probeEnabled()) {
+        if(servePath != NULL) {
+            taggedMsg(TM_error | TM_flush | TM_newline, "Probe mode can't serve executors");
+            deviceShutdown();
+            return EXIT_FAILURE;
+        }
+
+        taggedMsg(TM_info | TM_flush | TM_newline, "Probe mode: printing key events, no binds are loaded.");
+        grab = 0;
+        status = 0;
+    }
+    else if(servePath != NULL) {
+        /* A reader only matches the binds its executors register */
+        taggedMsg(TM_info | TM_flush | TM_newline, "Reader mode: binds are registered by executors.");
+        deviceResolveScopes();
+    }
+    else {
+        loadConfig(configPath);
+        deviceResolveScopes();
+        if(executorPath == NULL)
+            matcherLoad(matcherPath);
+        if(!pluginLoadAll(pluginBudget)) {
+            shutdownDaemon();
+            return EXIT_FAILURE;
+        }
+    }
+
+    /*** Set up event loop ***/
+    matches = !probeEnabled() && executorPath == NULL;
+    executes = !probeEnabled() && servePath == NULL;
+    if(!loopInit(backend) || (executes && !captureInit(outputLogPath, discardOutput)) || (matches && !deferInit(overlapWindow))) {
+        shutdownDaemon();
+        return EXIT_FAILURE;
+    }
+    for(n = 0; n < deviceCount(); ++n) {
+        struct inputDevice* device = deviceGet(n);
+
+        if(!loopAdd(device->fd, LK_device, n, device->events, sizeof(device->events)) || (grab && !passthroughInit(n, device->fd))) {
+            shutdownDaemon();
+            return EXIT_FAILURE;
+        }
+    }
+    if((servePath != NULL && !serveListen(servePath)) || (executorPath != NULL && !serveConnect(executorPath))) {
+        shutdownDaemon();
+        return EXIT_FAILURE;
+    }
+    if(loopGetBackend() == LB_uring)
+        taggedMsg(TM_info | TM_flush | TM_newline, "Using io_uring event loop.");
+
+    /*** Publish status ***/
+    if(status)
+        statusInit(statusPath);
+
+    /*** Enable low-latency mode ***/
+    /* Done after loading the config so that the bind tables are already allocated when memory is locked */
+    if(rtPriority > 0 || rtCPU >= 0) {
+        if(lowLatencyEnable(rtPriority, rtCPU))
+            taggedMsg(TM_info | TM_flush | TM_newline, "Low-latency mode enabled.");
+        else
+            taggedMsg(TM_warning | TM_flush | TM_newline, "Low-latency mode only partially enabled!");
+    }
 
     /*** Handle signals ***/
-    /* On interrupt, use the interruptHandler function */
+    /* On interrupt, use the interruptHandler function. Termination (like a service stop) and hangup shut down the same way,
+       so the status page and sockets are never left behind */
     signal(SIGINT, interruptHandler);
+    signal(SIGTERM, interruptHandler);
+    signal(SIGHUP, interruptHandler);
 
     /* Tell the kernel to automatically reap child processes (prevents defunct processes) */
     signal(SIGCHLD, SIG_IGN);
@@ -139,48 +536,83 @@ int main(int argc, char* argv[]) {
     /*** Wait for keys and parse them ***/
     taggedMsg(TM_info | TM_flush | TM_newline, "Started! Interrupt to exit.");
 
-    while(1) {
-        n = read(devFD, &ev, sizeof(ev));
-        if(n == sizeof(ev)) {
-            /* Read was successful! Parse stuff, reset fail counter and check if it is a keybind */
-            failNum = 0;
-            if(ev.type == EV_KEY) { /* Input is a key! Continue... */
-                /* Notes:
-                   - key autorepeats are ignored as we don't need to care about them for key combinations
-                   - single-key keybinds are triggered on key release and ONLY IF ALONE
-                   - multi-key keybinds are triggered on key press
-                   - key combos are ordered by ev.code value */
-
-                if(ev.value == 0) { /* Key released */
-                    removeKey(comboBuffer, &comboBufferN, ev.code);
-                    if(comboBufferN == 0)
-                        doSingleBind(ev.code);
+    /* Everything the event path needs is allocated by now (including stdout's buffer, by the message above)
+       Nothing is allocated from now on, so allocator jitter can't add latency */
+    sallocLock();
+
+    running = 1;
+    while(running) {
+        completionsN = loopWait(completions, BABYBINDS_LOOP_SLOTS);
+
+        for(n = 0; n < completionsN; ++n) {
+            if(completions[n].kind == LK_device) {
+                struct inputDevice* device = deviceGet(completions[n].index);
+
+                if(completions[n].result == -ENODEV) {
+                    /* Unplugged! Go on with the other devices, if there are any left */
+                    removeDevice(completions[n].index);
+                    if(deviceAttached() == 0) {
+                        taggedMsg(TM_error | TM_flush | TM_newline, "All input devices were removed! Aborting...");
+                        running = 0;
+                        break;
+                    }
                 }
-                else if(ev.value == 1) { /* Key pressed */
-                    insertKey(comboBuffer, &comboBufferN, ev.code);
-                    if(comboBufferN > 1)
-                        doBind(comboBuffer, comboBufferN);
+                else if(completions[n].result > 0 && completions[n].result % sizeof(struct input_event) == 0) {
+                    /* Read was successful! Reset fail counter and parse every event in the batch */
+                    const struct input_event* events = completions[n].buf;
+                    const size_t eventsN = completions[n].result / sizeof(struct input_event);
+                    size_t e;
+
+                    device->failNum = 0;
+                    if(probeEnabled())
+                        probeBatch(completions[n].index, events, eventsN);
+                    else {
+                        for(e = 0; e < eventsN; ++e)
+                            processEvent(completions[n].index, &events[e]);
+                    }
+                }
+                else {
+                    /* Read errored! Skip this batch, or abort, if too many failed reads. */
+                    if(device->failNum == 10) {
+                        taggedMsg(TM_error | TM_flush | TM_newline, "Input device read failed! Aborting (10 fails)...");
+                        running = 0;
+                        break;
+                    }
+
+                    taggedMsg(TM_warning | TM_flush | TM_newline, "Input device read failed! Ignoring and waiting...");
+
+                    /* Wait 3 seconds */
+                    sleep(3);
+
+                    /* Increment fail counter */
+                    ++device->failNum;
                 }
             }
-        }
-        else {
-            /* Read errored! Skip this iteration, or abort, if too many failed reads. */
-            if(failNum == 10) {
-                taggedMsg(TM_error | TM_flush | TM_newline, "Input device read failed! Aborting (10 fails)...");
+            else if(completions[n].kind == LK_capture)
+                captureHandle(&completions[n]);
+            else if(completions[n].kind == LK_timer)
+                doExpiredDeferredBinds();
+            else if(completions[n].kind == LK_listen)
+                serveAccept(&completions[n]);
+            else if(completions[n].kind == LK_executor)
+                serveHandle(&completions[n]);
+            else if(completions[n].kind == LK_deadline)
+                serveExpire();
+            else if(completions[n].kind == LK_reader && !serveReceive(&completions[n])) {
+                taggedMsg(TM_error | TM_flush | TM_newline, "The reader is gone! Aborting...");
+                running = 0;
                 break;
             }
-            
-            taggedMsg(TM_warning | TM_flush | TM_newline, "Input device read failed! Ignoring and waiting...");
-            
-            /* Wait 3 seconds */
-            sleep(3);
-            
-            /* Increment fail counter */
-            ++failNum;
         }
+
+        /* What this wakeup did goes to the log and the status page at once */
+        captureFlush();
+        statusPublish();
     }
 
     /*** Clean-up ***/
+    probeReport();
+    printStats(&stats);
     shutdownDaemon();
 
     return EXIT_SUCCESS;
@@ -4,6 +4,60 @@
 /* A global flag that indicates a memory error on a failed salloc. If 1, a failure has occured */
 static int salloc_fv = 0;
 
+/* A global flag that indicates that start-up is done and that nothing should be allocated anymore. If 1, allocating is an error */
+static int sallocLocked = 0;
+
+#ifdef BABYBINDS_ALLOC_GUARD
+/* For write and abort (stdio can't be used, it might allocate) */
+#include <unistd.h>
+
+/* glibc's real allocator, called by the interposed functions below */
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+/* Aborts if allocations are locked */
+static void sallocGuard(void) {
+    static const char msg[] = "[ERROR] Memory allocated or freed after start-up! Aborting...\n";
+
+    if(sallocLocked) {
+        write(STDERR_FILENO, msg, sizeof(msg) - 1);
+        abort();
+    }
+}
+
+void* malloc(size_t size) {
+    sallocGuard();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+    sallocGuard();
+    return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    sallocGuard();
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    /* Freeing NULL is not an allocation */
+    if(ptr != NULL)
+        sallocGuard();
+    __libc_free(ptr);
+}
+#endif
+
+void sallocLock(void) {
+    sallocLocked = 1;
+}
+
+void sallocUnlock(void) {
+    sallocLocked = 0;
+}
+
 int salloc_f(void) {
     return salloc_fv;
 }
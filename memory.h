@@ -27,6 +27,16 @@ void* salloc(void* ptr, size_t size);
  */
 void* sfree(void* ptr);
 
+/* Marks the end of start-up: from now on, no memory should be allocated or freed at all (not only through salloc/sfree)
+   When compiled with BABYBINDS_ALLOC_GUARD defined, malloc, calloc, realloc and free are interposed and abort the daemon
+   with an error message if called while locked. This makes sure the event path stays allocation-free (allocator jitter
+   adds latency) and can be checked by replaying a large input trace on a guarded build
+   Without BABYBINDS_ALLOC_GUARD, these do nothing */
+void sallocLock(void);
+
+/* Allows allocating again (for shutting down and other places that can allocate, like freshly forked children) */
+void sallocUnlock(void);
+
 /* Inserts an unique value (can only be one) to a fixed size int array using insertion sort
    Returns final size. If the size remains the same, an error occured
    Note that this function does not handle the check to see if the array will exceed its maximum size */
@@ -0,0 +1,210 @@
+/***** passthrough.h implementation *****/
+/* Needed for O_CLOEXEC */
+#define _GNU_SOURCE
+
+#include "passthrough.h"
+
+/* For errno */
+#include <errno.h>
+#include <string.h>
+
+/* For the uinput device */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+/* Size of a bit array with n bits */
+#define PASSTHROUGH_BITS_SIZE(n) ((n) / 8 + 1)
+
+/* Checks a bit in a bit array */
+#define PASSTHROUGH_BIT(array, bit) (((array)[(bit) / 8] >> ((bit) % 8)) & 1)
+
+/* Passthrough state of an input device */
+struct passthroughDevice {
+    /* uinput file descriptor, -1 if passthrough mode is not enabled */
+    int fd;
+    /* Events of the current report that are going to be passed through */
+    struct input_event batch[BABYBINDS_EVENT_BATCH];
+    size_t batchN;
+    /* 1 if the current report has something other than SYN and MSC events (MSC_SCAN of a swallowed key alone is pointless to pass) */
+    int batchUseful;
+    /* Keys with swallowed presses, so that their repeats and releases are swallowed too */
+    unsigned char swallowed[PASSTHROUGH_BITS_SIZE(KEY_MAX)];
+};
+
+/* Passthrough state of every input device (by device index) */
+static struct passthroughDevice passthroughDevices[BABYBINDS_MAX_DEVICES];
+static size_t passthroughDevicesN = 0;
+
+/* Process that created the uinput devices. Children share their open files, and destroying them there would destroy them
+   for the daemon too (while it still grabs the real devices), so only this process destroys them */
+static pid_t passthroughOwner = -1;
+
+/*** Internal functions ***/
+/* Copies the supported codes of an event type from the input device to the uinput device. Returns 1 on success, 0 on failure */
+static int passthroughCopyBits(int passthroughFD, int devFD, int type, int max, unsigned long setRequest);
+
+/* Writes the current report of a device to its uinput device */
+static void passthroughFlush(struct passthroughDevice* passthrough);
+
+/*** Implementations ***/
+static int passthroughCopyBits(int passthroughFD, int devFD, int type, int max, unsigned long setRequest) {
+    unsigned char bits[PASSTHROUGH_BITS_SIZE(KEY_MAX)];
+    int code;
+
+    memset(bits, 0, sizeof(bits));
+    if(ioctl(devFD, EVIOCGBIT(type, PASSTHROUGH_BITS_SIZE(max)), bits) < 0)
+        return 0;
+
+    if(ioctl(passthroughFD, UI_SET_EVBIT, type) < 0)
+        return 0;
+
+    for(code = 0; code <= max; ++code) {
+        if(PASSTHROUGH_BIT(bits, code) && ioctl(passthroughFD, setRequest, code) < 0)
+            return 0;
+    }
+
+    return 1;
+}
+
+static void passthroughFlush(struct passthroughDevice* passthrough) {
+    if(passthrough->batchUseful) {
+        /* uinput takes whole reports in one write. If it fails, the report is lost, waiting would stall the whole daemon */
+        if(write(passthrough->fd, passthrough->batch, passthrough->batchN * sizeof(struct input_event)) < 0)
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not pass events through: ", strerror(errno));
+    }
+
+    passthrough->batchN = 0;
+    passthrough->batchUseful = 0;
+}
+
+int passthroughInit(size_t index, int devFD) {
+    struct passthroughDevice* passthrough = &passthroughDevices[index];
+    unsigned char types[PASSTHROUGH_BITS_SIZE(EV_MAX)];
+    struct uinput_setup setup;
+    int passthroughFD;
+
+    /* Devices without passthrough before this one */
+    for(; passthroughDevicesN <= index; ++passthroughDevicesN)
+        passthroughDevices[passthroughDevicesN].fd = -1;
+
+    passthrough->batchN = 0;
+    passthrough->batchUseful = 0;
+    memset(passthrough->swallowed, 0, sizeof(passthrough->swallowed));
+
+    if(ioctl(devFD, EVIOCGRAB, 1) < 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not grab input device: ", strerror(errno));
+        return 0;
+    }
+
+    passthroughFD = passthrough->fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if(passthroughFD < 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not open /dev/uinput: ", strerror(errno));
+        ioctl(devFD, EVIOCGRAB, 0);
+        return 0;
+    }
+
+    /* Mirror the event types the passthrough cares about. Absolute axes are not mirrored (they need axis info), grab mode is for keyboards and the like */
+    memset(types, 0, sizeof(types));
+    if(ioctl(devFD, EVIOCGBIT(0, sizeof(types)), types) < 0
+        || (PASSTHROUGH_BIT(types, EV_KEY) && !passthroughCopyBits(passthroughFD, devFD, EV_KEY, KEY_MAX, UI_SET_KEYBIT))
+        || (PASSTHROUGH_BIT(types, EV_REL) && !passthroughCopyBits(passthroughFD, devFD, EV_REL, REL_MAX, UI_SET_RELBIT))
+        || (PASSTHROUGH_BIT(types, EV_MSC) && !passthroughCopyBits(passthroughFD, devFD, EV_MSC, MSC_MAX, UI_SET_MSCBIT))
+        || (PASSTHROUGH_BIT(types, EV_LED) && !passthroughCopyBits(passthroughFD, devFD, EV_LED, LED_MAX, UI_SET_LEDBIT))) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not set up uinput device capabilities: ", strerror(errno));
+        close(passthroughFD);
+        passthrough->fd = -1;
+        ioctl(devFD, EVIOCGRAB, 0);
+        return 0;
+    }
+
+    /* Let the kernel do autorepeat for the uinput device too, like it does for the real one */
+    if(PASSTHROUGH_BIT(types, EV_REP))
+        ioctl(passthroughFD, UI_SET_EVBIT, EV_REP);
+
+    memset(&setup, 0, sizeof(setup));
+    ioctl(devFD, EVIOCGID, &setup.id);
+    strcpy(setup.name, "babybinds passthrough");
+    if(ioctl(passthroughFD, UI_DEV_SETUP, &setup) < 0 || ioctl(passthroughFD, UI_DEV_CREATE) < 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not create uinput device: ", strerror(errno));
+        close(passthroughFD);
+        passthrough->fd = -1;
+        ioctl(devFD, EVIOCGRAB, 0);
+        return 0;
+    }
+
+    passthroughOwner = getpid();
+    return 1;
+}
+
+void passthroughEvent(size_t index, const struct input_event* ev, int consumed) {
+    struct passthroughDevice* passthrough = &passthroughDevices[index];
+
+    if(index >= passthroughDevicesN || passthrough->fd < 0)
+        return;
+
+    if(ev->type == EV_SYN) {
+        if(ev->code == SYN_REPORT) {
+            /* End of report: pass it through with its SYN_REPORT */
+            passthrough->batch[passthrough->batchN++] = *ev;
+            passthroughFlush(passthrough);
+        }
+        else if(ev->code == SYN_DROPPED) {
+            /* The kernel dropped events, so the current report is incomplete. Drop it too */
+            passthrough->batchN = 0;
+            passthrough->batchUseful = 0;
+        }
+        return;
+    }
+
+    if(ev->type == EV_KEY && ev->code <= KEY_MAX) {
+        if(ev->value == 1) { /* Press: decides if this key is swallowed until released */
+            if(consumed) {
+                passthrough->swallowed[ev->code / 8] |= (unsigned char)(1 << (ev->code % 8));
+                return;
+            }
+        }
+        else if(PASSTHROUGH_BIT(passthrough->swallowed, ev->code)) {
+            if(ev->value == 0) /* Release: stop swallowing */
+                passthrough->swallowed[ev->code / 8] &= (unsigned char)~(1 << (ev->code % 8));
+            return;
+        }
+    }
+
+    /* Add to report. A report too big for the batch is written in parts (the last slot is kept for the SYN_REPORT) */
+    if(passthrough->batchN == BABYBINDS_EVENT_BATCH - 1) {
+        passthrough->batchUseful = 1;
+        passthroughFlush(passthrough);
+    }
+
+    passthrough->batch[passthrough->batchN++] = *ev;
+    if(ev->type != EV_MSC)
+        passthrough->batchUseful = 1;
+}
+
+void passthroughRemove(size_t index) {
+    if(index >= passthroughDevicesN || passthroughDevices[index].fd < 0)
+        return;
+
+    if(getpid() == passthroughOwner)
+        ioctl(passthroughDevices[index].fd, UI_DEV_DESTROY);
+    close(passthroughDevices[index].fd);
+    passthroughDevices[index].fd = -1;
+}
+
+void passthroughShutdown(void) {
+    size_t n;
+
+    for(n = 0; n < passthroughDevicesN; ++n) {
+        if(passthroughDevices[n].fd > -1) {
+            if(getpid() == passthroughOwner)
+                ioctl(passthroughDevices[n].fd, UI_DEV_DESTROY);
+            close(passthroughDevices[n].fd);
+        }
+
+        passthroughDevices[n].fd = -1;
+    }
+
+    passthroughDevicesN = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef BABYBINDS_PASSTHROUGH_H
+#define BABYBINDS_PASSTHROUGH_H
+
+/***** All stuff related to grabbing input devices and passing their unbound events through uinput *****/
+/* For compile time settings */
+#include "globals.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* For input_event */
+#include <linux/input.h>
+
+/* In passthrough mode, every input device is grabbed (EVIOCGRAB), so nothing else (X, the console, ...) gets its events
+ * Everything that is not consumed by a bind is re-emitted through a uinput device with the same capabilities
+ * Events are batched until the SYN_REPORT that ends each report and written with a single write, so that
+ * normal typing only costs one extra syscall per report. Every input device gets its own uinput device */
+
+/* Grabs an input device (by device index) and creates its uinput device. Returns 1 on success, 0 on failure (the device is ungrabbed then) */
+int passthroughInit(size_t index, int devFD);
+
+/* Passes an event through, unless it belongs to a consumed key
+   consumed is only used for key presses: if not 0, the press and all of the key's repeats and its release are swallowed
+   Does nothing if passthrough mode is not enabled */
+void passthroughEvent(size_t index, const struct input_event* ev, int consumed);
+
+/* Destroys the uinput device of a removed input device (so that keys it held are released) */
+void passthroughRemove(size_t index);
+
+/* Destroys the uinput devices. The input devices are ungrabbed when they are closed */
+void passthroughShutdown(void);
+
+#endif
@@ -0,0 +1,192 @@
+/***** plugin.h implementation *****/
+/* Needed for sigsetjmp and sigaction */
+#define _GNU_SOURCE
+
+#include "plugin.h"
+
+/* For errno */
+#include <errno.h>
+#include <string.h>
+
+/* For the watchdog */
+#include <setjmp.h>
+#include <signal.h>
+
+/* For loading shared objects */
+#include <dlfcn.h>
+
+/* Plugin of a bind */
+struct pluginBind {
+    /* 1 if the bind's command starts with @ */
+    int isPlugin;
+    /* Shared object handle and entry function, NULL if not loaded (or disabled by the watchdog) */
+    void* handle;
+    babybindsPluginEntry entry;
+};
+
+/* Plugins of every bind (indexed by bind number) */
+static struct pluginBind* pluginBinds = NULL;
+static size_t pluginBindsN = 0;
+
+/* Watchdog budget */
+static struct itimerval pluginBudget;
+
+/* Where the watchdog jumps to when an entry takes too long, and whether an entry is running */
+static sigjmp_buf pluginJump;
+static volatile sig_atomic_t pluginRunning = 0;
+
+/*** Internal functions ***/
+/* SIGALRM handler: interrupts the running entry */
+static void pluginWatchdog(int signum);
+
+/*** Implementations ***/
+static void pluginWatchdog(int signum) {
+    (void)signum;
+
+    /* The timer might expire right after the entry returned, before being disarmed. Nothing to interrupt then */
+    if(pluginRunning) {
+        pluginRunning = 0;
+        siglongjmp(pluginJump, 1);
+    }
+}
+
+int pluginLoadAll(long budgetMs) {
+    struct sigaction watchdogAction;
+    int anyLoaded = 0;
+    size_t i;
+
+    pluginBudget.it_interval.tv_sec = 0;
+    pluginBudget.it_interval.tv_usec = 0;
+    pluginBudget.it_value.tv_sec = budgetMs / 1000;
+    pluginBudget.it_value.tv_usec = (budgetMs % 1000) * 1000;
+
+    if(bindNum == 0)
+        return 1;
+
+    pluginBinds = salloc(NULL, sizeof(struct pluginBind) * bindNum);
+    if(salloc_f())
+        return 0;
+    pluginBindsN = bindNum;
+
+    for(i = 0; i < bindNum; ++i) {
+        struct pluginBind* plugin = &pluginBinds[i];
+        char** args = comboExecs[i].elems;
+
+        plugin->isPlugin = (args[0][0] == '@');
+        plugin->handle = NULL;
+        plugin->entry = NULL;
+        if(!plugin->isPlugin)
+            continue;
+
+        /* Path without the @ and entry symbol (size includes the null terminator of the array) */
+        if(comboExecs[i].size < 3) {
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Plugin bind without entry symbol, ignoring: ", args[0]);
+            continue;
+        }
+
+        plugin->handle = dlopen(args[0] + 1, RTLD_NOW | RTLD_LOCAL);
+        if(plugin->handle == NULL) {
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not load plugin, ignoring: ", dlerror());
+            continue;
+        }
+
+        *(void**)&plugin->entry = dlsym(plugin->handle, args[1]);
+        if(plugin->entry == NULL) {
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Plugin entry symbol not found, ignoring: ", args[1]);
+            dlclose(plugin->handle);
+            plugin->handle = NULL;
+            continue;
+        }
+
+        anyLoaded = 1;
+    }
+
+    /* Watchdog handler (only needed if there is something to watch) */
+    if(anyLoaded) {
+        memset(&watchdogAction, 0, sizeof(watchdogAction));
+        watchdogAction.sa_handler = pluginWatchdog;
+        sigemptyset(&watchdogAction.sa_mask);
+        if(sigaction(SIGALRM, &watchdogAction, NULL) == -1)
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not set up plugin watchdog, plugins can block babybinds: ", strerror(errno));
+    }
+
+    return 1;
+}
+
+int pluginIsBind(size_t bind) {
+    return bind < pluginBindsN && pluginBinds[bind].isPlugin;
+}
+
+void pluginCall(size_t bind, char** args, const struct timeval* time) {
+    static const struct itimerval disarm = { { 0, 0 }, { 0, 0 } };
+    struct pluginBind* plugin = &pluginBinds[bind];
+    struct babybindsPluginCall call;
+
+    if(plugin->entry == NULL)
+        return;
+
+    call.abi = BABYBINDS_PLUGIN_ABI;
+    call.bind = (unsigned long)bind;
+    call.codes = comboBinds[bind].codes;
+    call.codesSize = comboBinds[bind].size;
+    call.timeSec = (long)time->tv_sec;
+    call.timeUsec = (long)time->tv_usec;
+    call.args = args + 2;
+
+    if(sigsetjmp(pluginJump, 1) == 0) {
+        int result;
+
+        /* Plugins are not bound by the no allocations after start-up rule */
+        sallocUnlock();
+        pluginRunning = 1;
+        setitimer(ITIMER_REAL, &pluginBudget, NULL);
+
+        result = plugin->entry(&call);
+
+        pluginRunning = 0;
+        setitimer(ITIMER_REAL, &disarm, NULL);
+        sallocLock();
+
+        if(result != 0)
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Plugin entry returned an error: ", comboExecs[bind].elems[1]);
+    }
+    else {
+        /* The watchdog interrupted the entry. Whatever the plugin was doing is left half-done, and its state is shared by all
+           of its entries, so none of them is called again (it isn't unloaded either, it might have threads or hold locks)
+           If it was inside libc, libc's state may be broken too: nothing can be done about that but warning */
+        void* const handle = plugin->handle;
+        size_t i;
+
+        sallocLock();
+        for(i = 0; i < pluginBindsN; ++i) {
+            if(pluginBinds[i].handle == handle)
+                pluginBinds[i].entry = NULL;
+        }
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Plugin entry took too long and was interrupted, disabling its plugin: ", comboExecs[bind].elems[1]);
+        taggedMsg(TM_warning | TM_flush | TM_newline, "If it was inside libc (like malloc or stdio), babybinds may hang or crash later. Restart it to be safe");
+    }
+}
+
+void pluginDrop(size_t bind) {
+    if(bind >= pluginBindsN)
+        return;
+
+    if(pluginBinds[bind].handle != NULL)
+        dlclose(pluginBinds[bind].handle);
+
+    pluginBinds[bind].handle = NULL;
+    pluginBinds[bind].entry = NULL;
+}
+
+void pluginShutdown(void) {
+    size_t i;
+
+    for(i = 0; i < pluginBindsN; ++i) {
+        if(pluginBinds[i].handle != NULL)
+            dlclose(pluginBinds[i].handle);
+    }
+
+    if(pluginBinds != NULL)
+        pluginBinds = sfree(pluginBinds);
+    pluginBindsN = 0;
+}
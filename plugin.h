@@ -0,0 +1,39 @@
+#ifndef BABYBINDS_PLUGIN_H
+#define BABYBINDS_PLUGIN_H
+
+/***** All stuff related to loading and calling plugin actions *****/
+/* For the plugin interface */
+#include "babybinds_plugin.h"
+
+/* For bind globals */
+#include "globals.h"
+
+/* For memory management */
+#include "memory.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* For struct timeval */
+#include <sys/time.h>
+
+/* Loads the plugins of all binds whose command starts with @ (see babybinds_plugin.h)
+   Binds whose plugin can't be loaded only print a warning and do nothing when triggered
+   budgetMs is how long an entry can run before the watchdog interrupts it
+   Returns 1 on success, 0 on failure (out of memory) */
+int pluginLoadAll(long budgetMs);
+
+/* Returns 1 if the bind is a plugin bind (even if its plugin couldn't be loaded), 0 if it is a regular command */
+int pluginIsBind(size_t bind);
+
+/* Calls the entry of a plugin bind with its argv (its command, with its argument template filled in), with the watchdog armed
+   An interrupted entry disables every bind of its plugin (see babybinds_plugin.h for why that is not a safe recovery) */
+void pluginCall(size_t bind, char** args, const struct timeval* time);
+
+/* Unloads the plugin of a bind (if it has one), which is never called again */
+void pluginDrop(size_t bind);
+
+/* Unloads all plugins */
+void pluginShutdown(void);
+
+#endif
@@ -1,7 +1,15 @@
 /***** printmsgs.h implementation *****/
 #include "printmsgs.h"
 
-void taggedMsg2(enum tagErrorLevel tags, const char* str1, char* str2) {
+/*** Internal functions ***/
+/* Prints the error-level tag of a message. Returns the stream the message goes to */
+static FILE* taggedStream(enum tagErrorLevel tags);
+
+/* Ends a message as told to by its tag */
+static void taggedEnd(enum tagErrorLevel tags, FILE* ostream);
+
+/*** Implementations ***/
+static FILE* taggedStream(enum tagErrorLevel tags) {
     /* Stream to output to */
     FILE* ostream;
 
@@ -26,13 +34,10 @@ void taggedMsg2(enum tagErrorLevel tags, const char* str1, char* str2) {
         break;
     }
 
-    /* Print first string */
-    fputs(str1, ostream);
-
-    /* Print second string if passed */
-    if(str2 != NULL)
-        fputs(str2, ostream);
+    return ostream;
+}
 
+static void taggedEnd(enum tagErrorLevel tags, FILE* ostream) {
     /* Print newline if told to by tag */
     if((tags & TM_newline) == TM_newline)
         fputc('\n', ostream);
@@ -42,13 +47,64 @@ void taggedMsg2(enum tagErrorLevel tags, const char* str1, char* str2) {
         fflush(ostream);
 }
 
+void taggedMsg2(enum tagErrorLevel tags, const char* str1, char* str2) {
+    FILE* const ostream = taggedStream(tags);
+
+    /* Print first string */
+    fputs(str1, ostream);
+
+    /* Print second string if passed */
+    if(str2 != NULL)
+        fputs(str2, ostream);
+
+    taggedEnd(tags, ostream);
+}
+
 void taggedMsg(enum tagErrorLevel tags, const char* str) {
     taggedMsg2(tags, str, NULL);
 }
 
+void taggedMsgf(enum tagErrorLevel tags, const char* format, ...) {
+    FILE* const ostream = taggedStream(tags);
+    va_list args;
+
+    va_start(args, format);
+    vfprintf(ostream, format, args);
+    va_end(args);
+
+    taggedEnd(tags, ostream);
+}
+
 void printUsage(const char* binName) {
     printf("Usage:\n");
-    printf("%s <input device path>\n", binName);
+    printf("%s [options] [<label>[,<group>]=]<input device path> [...]\n", binName);
+    printf("%s [options] --executor <reader socket path>\n", binName);
+    printf("%s --compile <output path>\n", binName);
+    printf("Options:\n");
+    printf("  -f, --config <path>        Config file to load (default: ~/.babybindsrc)\n");
+    printf("  -r, --realtime <priority>  Low-latency mode: SCHED_FIFO with the given priority (1-99), locked and pre-faulted memory\n");
+    printf("  -c, --cpu <cpu>            Low-latency mode: pin to the given CPU\n");
+    printf("  -b, --backend <backend>    Event loop backend: epoll (default) or uring (falls back to epoll if unavailable)\n");
+    printf("  -o, --output-log <path>    Log file for the output of commands (default: ~/.babybinds.log)\n");
+    printf("  -n, --discard-output       Send the output of commands to /dev/null instead of logging it\n");
+    printf("  -g, --grab                 Grab the input devices and pass everything not consumed by a bind through uinput\n");
+    printf("  -p, --probe                Print key events with their names and measure the devices instead of binding keys\n");
+    printf("  -l, --serve <path>         Reader mode: own the input devices and match the binds of executors connecting to this socket\n");
+    printf("  -e, --executor <path>      Executor mode: register the config with the reader on this socket and execute its binds\n");
+    printf("  -C, --compile <path>       Compile the config into C source for a matcher (- for stdout) and exit\n");
+    printf("  -m, --matcher <path>       Compiled matcher to load (default: ~/.babybindsrc.so, if it exists)\n");
+    printf("  -P, --plugin-budget <ms>   Time a plugin entry can run before being interrupted and disabled (default: %d)\n", BABYBINDS_PLUGIN_BUDGET);
+    printf("  -d, --debounce <ms>        Drop key presses closer than this to the previous transition of the same key (chatter)\n");
+    printf("  -D, --debounce-key <keycode>=<ms>  Debounce window of a single key, overriding --debounce (repeatable)\n");
+    printf("  -s, --status <path>        Status page for monitors (default: /dev/shm/babybinds.<pid>, see babybinds_status.h)\n");
+    printf("  -S, --no-status            Don't publish a status page\n");
+    printf("  -w, --overlap-window <ms>  Time a combo waits for a longer combo containing it before triggering (default: %d, 0 to disable)\n", BABYBINDS_OVERLAP_WINDOW);
+    fflush(stdout);
+}
+
+void printStats(const struct daemonStats* daemonStats) {
+    printf("[INFO] Stats: %lu events, %lu key events, %lu debounced, %lu binds triggered\n",
+           daemonStats->events, daemonStats->keyEvents, daemonStats->debounced, daemonStats->triggers);
     fflush(stdout);
 }
 
@@ -5,18 +5,30 @@
 /* For tagErrorLevel */
 #include "datatypes.h"
 
+/* For compile time settings (shown in the usage) */
+#include "globals.h"
+
 /* Standard includes */
 #include <stdio.h>
 
+/* For taggedMsgf */
+#include <stdarg.h>
+
 /* Prints 1/2 string(s) with a error-level tag before it */
 void taggedMsg2(enum tagErrorLevel tags, const char* str1, char* str2);
 
 /* Syntax friendly single string version of taggedMsg2 */
 void taggedMsg(enum tagErrorLevel tags, const char* str);
 
+/* Version of taggedMsg2 for messages with numbers: prints a printf format with its arguments after the tag */
+void taggedMsgf(enum tagErrorLevel tags, const char* format, ...);
+
 /* Prints program usage */
 void printUsage(const char* binName);
 
+/* Prints the stats of the daemon */
+void printStats(const struct daemonStats* daemonStats);
+
 /* Prints parsed commands in a human-readable way. Args is a null terminated ARRAY (last element is a NULL pointer) */
 void printCommand(char** args, size_t size);
 
@@ -0,0 +1,198 @@
+/***** probe.h implementation *****/
+/* Needed for clock_gettime */
+#define _GNU_SOURCE
+
+#include "probe.h"
+
+/* For the time a batch is read */
+#include <time.h>
+
+/* Number of histogram buckets. Time bucket n counts [2^n, 2^(n+1)) microseconds (bucket 0 also gets 0)
+   Size bucket n counts reports of n events (the last bucket, bigger ones too) */
+#define PROBE_BUCKETS 32
+
+/* Width of the longest histogram bar */
+#define PROBE_BAR 40
+
+/* Distribution of a measurement */
+struct probeHistogram {
+    unsigned long buckets[PROBE_BUCKETS];
+    /* Number of samples, smallest, biggest and sum of all of them (for the mean) */
+    unsigned long n;
+    unsigned long min;
+    unsigned long max;
+    double sum;
+};
+
+/* Measurements of a device */
+struct probeDevice {
+    /* Report intervals, report sizes and read delays (see probe.h) */
+    struct probeHistogram interval;
+    struct probeHistogram size;
+    struct probeHistogram delay;
+    /* Timestamp of the last SYN_REPORT, if hasLast */
+    struct timeval lastReport;
+    int hasLast;
+    /* Events since the last SYN_REPORT */
+    unsigned long reportEvents;
+    /* Times the kernel buffer of the device overflowed (SYN_DROPPED) */
+    unsigned long dropped;
+};
+
+static struct probeDevice probeDevices[BABYBINDS_MAX_DEVICES];
+static int probeOn = 0;
+
+/*** Internal functions ***/
+/* Adds a sample to a histogram (negative samples, from clock jumps, count as 0). Times go to power of 2 buckets */
+static void probeCount(struct probeHistogram* histogram, long value, int isTime);
+
+/* Returns a - b in microseconds */
+static long probeDiff(const struct timeval* a, const struct timeval* b);
+
+/* Prints a histogram with its title, skipping the empty buckets before the first sample and after the last one */
+static void probePrint(const char* title, const struct probeHistogram* histogram, int isTime);
+
+/*** Implementations ***/
+static void probeCount(struct probeHistogram* histogram, long value, int isTime) {
+    const unsigned long sample = value > 0 ? (unsigned long)value : 0;
+    unsigned long rest = sample;
+    size_t bucket = 0;
+
+    if(isTime) {
+        while(bucket < PROBE_BUCKETS - 1 && rest >= 2) {
+            rest /= 2;
+            ++bucket;
+        }
+    }
+    else
+        bucket = sample < PROBE_BUCKETS ? sample : PROBE_BUCKETS - 1;
+
+    ++histogram->buckets[bucket];
+    if(histogram->n == 0 || sample < histogram->min)
+        histogram->min = sample;
+    if(histogram->n == 0 || sample > histogram->max)
+        histogram->max = sample;
+    histogram->sum += (double)sample;
+    ++histogram->n;
+}
+
+static long probeDiff(const struct timeval* a, const struct timeval* b) {
+    return (long)(a->tv_sec - b->tv_sec) * 1000000 + (long)(a->tv_usec - b->tv_usec);
+}
+
+static void probePrint(const char* title, const struct probeHistogram* histogram, int isTime) {
+    unsigned long most = 0;
+    size_t first;
+    size_t last;
+    size_t n;
+
+    printf("  %s: %lu samples", title, histogram->n);
+    if(histogram->n == 0) {
+        putchar('\n');
+        return;
+    }
+    printf(", min %lu, mean %.1f, max %lu\n", histogram->min, histogram->sum / (double)histogram->n, histogram->max);
+
+    for(first = 0; histogram->buckets[first] == 0; ++first);
+    for(last = PROBE_BUCKETS - 1; histogram->buckets[last] == 0; --last);
+    for(n = first; n <= last; ++n) {
+        if(histogram->buckets[n] > most)
+            most = histogram->buckets[n];
+    }
+
+    for(n = first; n <= last; ++n) {
+        /* Non-empty buckets always get some bar */
+        const unsigned long bar = (histogram->buckets[n] * PROBE_BAR + most - 1) / most;
+        unsigned long b;
+
+        if(isTime)
+            printf("    %10lu - %-10lu us ", n == 0 ? 0UL : 1UL << n, (2UL << n) - 1);
+        else if(n == PROBE_BUCKETS - 1)
+            printf("    %10lu+ events         ", (unsigned long)n);
+        else
+            printf("    %10lu events          ", (unsigned long)n);
+
+        for(b = 0; b < bar; ++b)
+            putchar('#');
+        printf(" %lu\n", histogram->buckets[n]);
+    }
+}
+
+void probeEnable(void) {
+    probeOn = 1;
+}
+
+int probeEnabled(void) {
+    return probeOn;
+}
+
+void probeBatch(size_t index, const struct input_event* events, size_t eventsN) {
+    struct probeDevice* probe = &probeDevices[index];
+    struct timespec readSpec;
+    struct timeval readTime;
+    int hasReadTime;
+    size_t e;
+
+    /* When the batch got here (once for the whole batch, so its reports show how long they waited in it) */
+    hasReadTime = clock_gettime(deviceClock(), &readSpec) == 0;
+    readTime.tv_sec = readSpec.tv_sec;
+    readTime.tv_usec = readSpec.tv_nsec / 1000;
+
+    for(e = 0; e < eventsN; ++e) {
+        const struct input_event* ev = &events[e];
+
+        ++stats.events;
+
+        if(ev->type == EV_SYN && ev->code == SYN_REPORT) {
+            probeCount(&probe->size, (long)probe->reportEvents, 0);
+            probe->reportEvents = 0;
+
+            if(probe->hasLast)
+                probeCount(&probe->interval, probeDiff(&ev->time, &probe->lastReport), 1);
+            probe->lastReport = ev->time;
+            probe->hasLast = 1;
+
+            if(hasReadTime)
+                probeCount(&probe->delay, probeDiff(&readTime, &ev->time), 1);
+        }
+        else if(ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+            /* The kernel buffer overflowed: the report being read is incomplete, and the interval to the next one is not real */
+            ++probe->dropped;
+            probe->reportEvents = 0;
+            probe->hasLast = 0;
+            printf("[%s] %ld.%06ld SYN_DROPPED (events were lost)\n", deviceName(index), (long)ev->time.tv_sec, (long)ev->time.tv_usec);
+        }
+        else {
+            ++probe->reportEvents;
+
+            if(ev->type == EV_KEY) {
+                const char* name = keyName(ev->code);
+
+                ++stats.keyEvents;
+                printf("[%s] %ld.%06ld %s (%u) %s\n", deviceName(index), (long)ev->time.tv_sec, (long)ev->time.tv_usec,
+                       name != NULL ? name : "unknown", (unsigned int)ev->code,
+                       ev->value == 0 ? "released" : (ev->value == 1 ? "pressed" : "repeated"));
+            }
+        }
+    }
+
+    fflush(stdout);
+}
+
+void probeReport(void) {
+    size_t n;
+
+    if(!probeOn)
+        return;
+
+    for(n = 0; n < deviceCount(); ++n) {
+        const struct probeDevice* probe = &probeDevices[n];
+
+        taggedMsgf(TM_info | TM_newline, "Probe of %s: %lu reports, %lu overflows (SYN_DROPPED)", deviceName(n), probe->size.n, probe->dropped);
+        probePrint("Report interval (us)", &probe->interval, 1);
+        probePrint("Report size (events)", &probe->size, 0);
+        probePrint("Read delay (us)", &probe->delay, 1);
+    }
+
+    fflush(stdout);
+}
@@ -0,0 +1,41 @@
+#ifndef BABYBINDS_PROBE_H
+#define BABYBINDS_PROBE_H
+
+/***** All stuff related to probe mode (printing key events and measuring the input devices instead of binding keys) *****/
+/* For the stats and compile time settings */
+#include "globals.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* For the names and the timestamp clock of input devices */
+#include "device.h"
+
+/* For printing keycode names */
+#include "keynames.h"
+
+/* For input_event */
+#include <linux/input.h>
+
+/* Probe mode loads no config and triggers nothing. Every key event is printed with its device, timestamp, name and code,
+ * and each device is measured, to tell whether the device, the kernel or babybinds adds latency:
+ * - Report interval: time between the SYN_REPORTs of the device (kernel timestamps), so its report rate and jitter
+ * - Report size: events in each report, without the SYN_REPORT itself
+ * - Read delay: time from the kernel timestamp of a SYN_REPORT to babybinds getting the batch that has it. This is the
+ *   delay of the kernel, the event loop and scheduling (see --realtime), as the device is done by then
+ * Times are kept in power of 2 buckets of microseconds, like the latencies of the status page. The histograms are
+ * printed when babybinds exits */
+
+/* Enables probe mode */
+void probeEnable(void);
+
+/* Returns 1 if probe mode is enabled */
+int probeEnabled(void);
+
+/* Prints and measures a batch of events read from a device (by index) */
+void probeBatch(size_t index, const struct input_event* events, size_t eventsN);
+
+/* Prints the histograms of every device (nothing if probe mode is not enabled) */
+void probeReport(void);
+
+#endif
@@ -0,0 +1,99 @@
+/***** realtime.h implementation *****/
+/* Needed for sched_setaffinity and the CPU_* macros */
+#define _GNU_SOURCE
+
+#include "realtime.h"
+
+/* For errno */
+#include <errno.h>
+#include <string.h>
+
+/* For scheduling, affinity and memory locking */
+#include <sched.h>
+#include <sys/mman.h>
+
+/* Flags that indicate which parts of the low-latency mode are active (so children only reset what was changed) */
+static int realtimeSched = 0;
+static int realtimePinned = 0;
+
+/* Affinity mask the process had before being pinned */
+static cpu_set_t originalAffinity;
+
+/* Touches BABYBINDS_PREFAULT_STACK bytes of stack so that the pages are already mapped (and locked) when the event loop needs them */
+static void prefaultStack(void) {
+    volatile char stackPages[BABYBINDS_PREFAULT_STACK];
+    size_t n;
+
+    /* Write to every byte instead of every page, the page size is not important enough to query here */
+    for(n = 0; n < BABYBINDS_PREFAULT_STACK; ++n)
+        stackPages[n] = 0;
+
+    /* Read back the last byte so the compiler doesn't complain about (or optimize away) the array */
+    (void)stackPages[BABYBINDS_PREFAULT_STACK - 1];
+}
+
+int lowLatencyEnable(int priority, int cpu) {
+    int success = 1;
+
+    /* Pin to CPU, saving the previous affinity first */
+    if(cpu >= 0) {
+        cpu_set_t pinnedAffinity;
+
+        if(cpu >= CPU_SETSIZE) {
+            taggedMsg(TM_warning | TM_flush | TM_newline, "CPU number too big, not pinning");
+            success = 0;
+        }
+        else if(sched_getaffinity(0, sizeof(cpu_set_t), &originalAffinity) == -1) {
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not get CPU affinity, not pinning: ", strerror(errno));
+            success = 0;
+        }
+        else {
+            CPU_ZERO(&pinnedAffinity);
+            CPU_SET(cpu, &pinnedAffinity);
+            if(sched_setaffinity(0, sizeof(cpu_set_t), &pinnedAffinity) == -1) {
+                taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not pin to CPU: ", strerror(errno));
+                success = 0;
+            }
+            else
+                realtimePinned = 1;
+        }
+    }
+
+    /* Switch to real-time scheduling */
+    if(priority > 0) {
+        struct sched_param param;
+
+        param.sched_priority = priority;
+        if(sched_setscheduler(0, SCHED_FIFO, &param) == -1) {
+            taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not switch to SCHED_FIFO: ", strerror(errno));
+            success = 0;
+        }
+        else
+            realtimeSched = 1;
+    }
+
+    /* Lock all memory (including future allocations) so that it is never swapped out, then pre-fault the stack */
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not lock memory: ", strerror(errno));
+        success = 0;
+    }
+    prefaultStack();
+
+    return success;
+}
+
+void lowLatencyChildReset(void) {
+    /* Back to normal scheduling. Errors are ignored, as there is nothing useful the child can do about them */
+    if(realtimeSched) {
+        struct sched_param param;
+
+        param.sched_priority = 0;
+        sched_setscheduler(0, SCHED_OTHER, &param);
+    }
+
+    /* Unpin from the CPU */
+    if(realtimePinned)
+        sched_setaffinity(0, sizeof(cpu_set_t), &originalAffinity);
+
+    /* Note that memory locks are not inherited by forked children, so there is no need to unlock anything */
+}
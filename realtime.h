@@ -0,0 +1,24 @@
+#ifndef BABYBINDS_REALTIME_H
+#define BABYBINDS_REALTIME_H
+
+/***** All stuff related to the low-latency runtime mode (scheduling, CPU affinity and memory locking) *****/
+/* For compile time settings */
+#include "globals.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* Enables the low-latency mode for the whole process (which is the event-reading path, as babybinds is single-threaded):
+ * - If priority is positive, the process is switched to SCHED_FIFO with that priority
+ * - If cpu is not negative, the process is pinned to that CPU. The original affinity is saved so that children can be unpinned
+ * - All current and future memory is locked and BABYBINDS_PREFAULT_STACK bytes of stack are pre-faulted
+ * Each step that fails only prints a warning, as the daemon still works (just slower) without it
+ * Returns 1 if everything was enabled, 0 if at least one step failed */
+int lowLatencyEnable(int priority, int cpu);
+
+/* Resets the scheduling policy and CPU affinity of the calling process to what it was before lowLatencyEnable
+   Meant to be called in a freshly forked child, before exec, so that spawned commands don't inherit real-time privileges
+   Does nothing if the low-latency mode was not enabled */
+void lowLatencyChildReset(void);
+
+#endif
@@ -0,0 +1,773 @@
+/***** serve.h implementation *****/
+/* Needed for SO_PEERCRED and struct ucred */
+#define _GNU_SOURCE
+
+#include "serve.h"
+
+/* For adding, indexing and dropping the binds of executors */
+#include "config.h"
+
+/* For errno */
+#include <errno.h>
+#include <string.h>
+
+/* For the unix socket and finding the active session */
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/* For the registration deadline timer */
+#include <sys/timerfd.h>
+#include <time.h>
+
+/* Version of the messages (see serve.h). Increased whenever they change */
+#define SERVE_VERSION 1
+
+/* Where the active session is found: the state of the first seat kept by systemd-logind (ACTIVE=<session> and
+   ACTIVE_UID=<uid> lines), or else the active virtual terminal (its device is owned by the user logged in on it) */
+#define SERVE_SEAT_PATH "/run/systemd/seats/seat0"
+#define SERVE_VT_PATH "/sys/class/tty/tty0/active"
+
+/* Size of session names (logind uses the audit session ID, a decimal number, or names like "c1") */
+#define SERVE_SESSION_SIZE 32
+
+/* Sources of the active session (see serveActive) */
+#define SERVE_ACTIVE_NONE 0
+#define SERVE_ACTIVE_SEAT 1
+#define SERVE_ACTIVE_VT 2
+
+/* An executor connected to the reader */
+struct serveClient {
+    /* Socket, -1 if the slot is free */
+    int fd;
+    /* User of the executor, for messages and BABYBINDS_SERVE_USER_CLIENTS */
+    unsigned long uid;
+    /* Second (of CLOCK_MONOTONIC) by which its registration must be done */
+    time_t deadline;
+    /* Session of the executor process (its audit session ID, as logind names sessions), empty if it has none */
+    char session[SERVE_SESSION_SIZE];
+    /* Its hello (once hasHello) and the number of scope names and binds received so far */
+    struct serveHello hello;
+    int hasHello;
+    size_t scopesN;
+    size_t bindsN;
+    /* Scope of the reader of each of its scope names */
+    size_t* scopes;
+    /* 1 once its registration is done. Triggers are only sent from then on */
+    int registered;
+    /* Read buffer, big enough for any message (longer ones are cut, so their size is wrong and they are rejected) */
+    union {
+        struct serveHello hello;
+        struct serveBind bind;
+        char name[BABYBINDS_SERVE_NAME];
+    } buf;
+};
+
+/* Owner of a bind of the reader */
+struct serveOwner {
+    /* Slot of the executor, or -1 if no executor owns it (anymore) */
+    long client;
+    /* Bind number of the executor */
+    unsigned long bind;
+    /* Next bind of another executor with the same scope and keycodes, -1 if none. The matchers only find the first one,
+       and this one triggers all of them, so every executor gets its binds even if another has the same combo */
+    long next;
+};
+
+/* Reader: connected executors, owner of each bind (by bind number, serveOwnersN of them), listening socket and its path */
+static struct serveClient serveClients[BABYBINDS_SERVE_CLIENTS];
+static struct serveOwner* serveOwners = NULL;
+static size_t serveOwnersN = 0;
+
+/* Reader: binds of all executors, counted as they arrive (see BABYBINDS_SERVE_TOTAL_BINDS) */
+static size_t serveBindsTotal = 0;
+static int serveListenFD = -1;
+static char* servePath = NULL;
+
+/* Reader: where the active session is found (SERVE_ACTIVE_*) */
+static int serveActiveSource = SERVE_ACTIVE_NONE;
+
+/* Reader: timer of the registration deadlines (and its read buffer, which gets the expiration count) */
+static int serveDeadlineFD = -1;
+static unsigned char serveDeadlineBuf[8];
+
+/* Process that created the socket file. Children that fail to exec shut down too, and must not remove it */
+static pid_t serveSocketOwner = -1;
+
+/* Executor: socket connected to the reader and the read buffer of triggers */
+static int serveReaderFD = -1;
+static struct serveTrigger serveIncoming;
+
+/*** Internal functions ***/
+/* Runs the next step of the registration of an executor with the message in its buffer (size bytes)
+   Returns 1 on success, 0 if the executor must be disconnected (prints a warning) */
+static int serveRegister(struct serveClient* client, size_t size);
+
+/* Adds a bind of an executor to the bind tables. Returns 1 on success, 0 on failure (prints a warning) */
+static int serveAddBind(struct serveClient* client, const struct serveBind* bind);
+
+/* Ends the registration of an executor: indexes the binds and replies. Returns 1 on success, 0 on failure */
+static int serveFinish(struct serveClient* client);
+
+/* Disconnects an executor and drops its binds */
+static void serveDisconnect(struct serveClient* client);
+
+/* Links the binds of executors with the same scope and keycodes (see serveOwner.next)
+   This is O(bindNum^2 * BABYBINDS_COMBOBUFFER_SIZE) like indexKeybinds, but only runs when executors come and go */
+static void serveLinkBinds(void);
+
+/* Arms the deadline timer for the earliest deadline of the executors still registering, or disarms it if there are none */
+static void serveArmDeadline(void);
+
+/* Reads a small file (no allocation, it runs for every trigger) into buf, null-terminated and without trailing newline
+   Returns 1 on success, 0 on failure */
+static int serveReadFile(const char* path, char* buf, size_t size);
+
+/* Finds a NAME=value line in text and copies the value to dst (size bytes at most, with null terminator)
+   Returns 1 if found, 0 if not */
+static int serveFindField(const char* text, const char* name, char* dst, size_t size);
+
+/* Finds the user and session (empty if unknown) of the active session. Returns 1 on success, 0 if it is unknown */
+static int serveActive(unsigned long* uid, char* session);
+
+/* Returns 1 if an executor belongs to the active session: same session if both are known, else same user. 0 if not */
+static int serveIsActive(const struct serveClient* client, unsigned long activeUid, const char* activeSession);
+
+/*** Implementations ***/
+static int serveRegister(struct serveClient* client, size_t size) {
+    if(client->registered) {
+        taggedMsg(TM_warning | TM_flush | TM_newline, "Unexpected message from a registered executor, disconnecting it");
+        return 0;
+    }
+
+    if(!client->hasHello) {
+        const struct serveHello* hello = &client->buf.hello;
+
+        if(size != sizeof(struct serveHello) || hello->version != SERVE_VERSION || hello->comboBufferSize != BABYBINDS_COMBOBUFFER_SIZE
+            || hello->scopeNum > BABYBINDS_SERVE_SCOPES || hello->bindNum > BABYBINDS_SERVE_BINDS) {
+            taggedMsg(TM_warning | TM_flush | TM_newline, "Executor rejected (another version or build of babybinds, or too many binds)");
+            return 0;
+        }
+
+        client->hello = *hello;
+        client->hasHello = 1;
+        if(hello->scopeNum > 0) {
+            client->scopes = salloc(NULL, sizeof(size_t) * hello->scopeNum);
+            if(salloc_f())
+                return 0; /* Out of memory! */
+        }
+    }
+    else if(client->scopesN < client->hello.scopeNum) {
+        size_t scope;
+
+        if(size >= BABYBINDS_SERVE_NAME || memchr(client->buf.name, '\0', size) != NULL) {
+            taggedMsg(TM_warning | TM_flush | TM_newline, "Executor sent an invalid scope name, disconnecting it");
+            return 0;
+        }
+
+        /* Scope names are never removed (views use them), so only so many can be added */
+        scope = findScope(client->buf.name, size);
+        if(scope == 0 && scopeNum >= BABYBINDS_SERVE_SCOPES) {
+            taggedMsg(TM_warning | TM_flush | TM_newline, "Executor rejected (too many scope names)");
+            return 0;
+        }
+        if(scope == 0 && (scope = addScope(client->buf.name, size)) == 0)
+            return 0; /* Out of memory! */
+
+        client->scopes[client->scopesN++] = scope;
+    }
+    else {
+        /* Binds only count once they arrive, so announcing many and never sending them takes nothing from other executors */
+        if(serveBindsTotal >= BABYBINDS_SERVE_TOTAL_BINDS) {
+            taggedMsg(TM_warning | TM_flush | TM_newline, "Executor rejected (the executors have too many binds already)");
+            return 0;
+        }
+
+        if(size != sizeof(struct serveBind) || !serveAddBind(client, &client->buf.bind))
+            return 0;
+
+        ++client->bindsN;
+        ++serveBindsTotal;
+    }
+
+    /* Everything received? */
+    if(client->scopesN == client->hello.scopeNum && client->bindsN == client->hello.bindNum)
+        return serveFinish(client);
+
+    return 1;
+}
+
+static int serveAddBind(struct serveClient* client, const struct serveBind* bind) {
+    int codes[BABYBINDS_COMBOBUFFER_SIZE];
+    size_t scope;
+    size_t thisNum;
+    size_t n;
+
+    if(bind->size == 0 || bind->size > BABYBINDS_COMBOBUFFER_SIZE || bind->scope > client->hello.scopeNum) {
+        taggedMsg(TM_warning | TM_flush | TM_newline, "Executor sent an invalid bind, disconnecting it");
+        return 0;
+    }
+
+    for(n = 0; n < bind->size; ++n) {
+        if(bind->codes[n] < 0 || bind->codes[n] >= KEY_CNT) {
+            taggedMsg(TM_warning | TM_flush | TM_newline, "Executor sent an invalid keycode, disconnecting it");
+            return 0;
+        }
+        codes[n] = bind->codes[n];
+    }
+
+    /* The command stays in the executor, the reader only has an empty one */
+    scope = bind->scope == 0 ? 0 : client->scopes[bind->scope - 1];
+
+    /* Binds dropped by executors that left are reused, so the tables never grow past the binds of the executors connected
+       at the same time (a reader has no binds of its own, so every dropped bind was an executor's) */
+    for(thisNum = 0; thisNum < bindNum && comboBinds[thisNum].codes != NULL; ++thisNum);
+
+    if(thisNum < bindNum) {
+        if(!setKeybind(thisNum, scope, codes, (size_t)bind->size, "", 0)) {
+            dropBind(thisNum);
+            return 0;
+        }
+    }
+    else {
+        /* Make room for its owner first, so that the bind never exists without one */
+        serveOwners = salloc(serveOwners, sizeof(struct serveOwner) * (thisNum + 1));
+        if(salloc_f())
+            return 0; /* Out of memory! */
+        for(; serveOwnersN < thisNum + 1; ++serveOwnersN) {
+            serveOwners[serveOwnersN].client = -1;
+            serveOwners[serveOwnersN].next = -1;
+        }
+
+        /* If adding fails (out of memory), the bind number is taken back so that the tables stay consistent */
+        if(!addKeybind(scope, codes, (size_t)bind->size, "", 0)) {
+            bindNum = thisNum;
+            return 0;
+        }
+    }
+
+    serveOwners[thisNum].client = (long)(client - serveClients);
+    serveOwners[thisNum].bind = (unsigned long)client->bindsN;
+    return 1;
+}
+
+static int serveFinish(struct serveClient* client) {
+    struct serveHello reply;
+
+    /* The new binds can be supersets of others or have the same combo as others, and their scopes need views */
+    indexKeybinds();
+    serveLinkBinds();
+    deviceResolveScopes();
+
+    reply = client->hello;
+    reply.clock = (long)deviceClock();
+    if(send(client->fd, &reply, sizeof(reply), MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)sizeof(reply)) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not reply to executor: ", strerror(errno));
+        return 0;
+    }
+
+    client->registered = 1;
+    taggedMsgf(TM_info | TM_flush | TM_newline, "Executor of uid %lu registered %lu binds (%lu of all executors)", client->uid, client->hello.bindNum,
+               (unsigned long)serveBindsTotal);
+    return 1;
+}
+
+static void serveDisconnect(struct serveClient* client) {
+    const long slot = (long)(client - serveClients);
+    size_t n;
+
+    /* A view can be waiting to trigger one of its binds */
+    for(n = 0; n < deviceViewCount(); ++n) {
+        struct keyView* view = deviceGetView(n);
+
+        if(view->deferredBind >= 0 && (size_t)view->deferredBind < serveOwnersN && serveOwners[view->deferredBind].client == slot)
+            view->deferredBind = -1;
+    }
+
+    for(n = 0; n < serveOwnersN; ++n) {
+        if(serveOwners[n].client == slot) {
+            dropBind(n);
+            serveOwners[n].client = -1;
+        }
+    }
+
+    serveBindsTotal -= client->bindsN;
+
+    /* Binds that were only ambiguous because of its binds can trigger right away now */
+    indexKeybinds();
+    serveLinkBinds();
+
+    taggedMsgf(TM_info | TM_flush | TM_newline, "Executor of uid %lu disconnected, its binds were dropped", client->uid);
+
+    loopRemove(client->fd);
+    close(client->fd);
+    client->fd = -1;
+    if(client->scopes != NULL)
+        client->scopes = sfree(client->scopes);
+}
+
+static void serveLinkBinds(void) {
+    size_t i;
+    size_t j;
+
+    for(i = 0; i < serveOwnersN; ++i) {
+        serveOwners[i].next = -1;
+        if(serveOwners[i].client < 0)
+            continue;
+
+        for(j = i + 1; j < serveOwnersN; ++j) {
+            if(serveOwners[j].client >= 0 && comboBinds[j].scope == comboBinds[i].scope && comboBinds[j].size == comboBinds[i].size
+                && memcmp(comboBinds[j].codes, comboBinds[i].codes, sizeof(int) * comboBinds[i].size) == 0) {
+                serveOwners[i].next = (long)j;
+                break;
+            }
+        }
+    }
+}
+
+static void serveArmDeadline(void) {
+    struct itimerspec expiration;
+    size_t n;
+
+    /* A zero expiration disarms the timer */
+    memset(&expiration, 0, sizeof(expiration));
+    for(n = 0; n < BABYBINDS_SERVE_CLIENTS; ++n) {
+        if(serveClients[n].fd > -1 && !serveClients[n].registered
+            && (expiration.it_value.tv_sec == 0 || serveClients[n].deadline < expiration.it_value.tv_sec))
+            expiration.it_value.tv_sec = serveClients[n].deadline;
+    }
+
+    if(timerfd_settime(serveDeadlineFD, TFD_TIMER_ABSTIME, &expiration, NULL) < 0)
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not arm the registration deadline timer: ", strerror(errno));
+}
+
+static int serveReadFile(const char* path, char* buf, size_t size) {
+    ssize_t n;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+        return 0;
+    n = read(fd, buf, size - 1);
+    close(fd);
+    if(n < 0)
+        return 0;
+
+    while(n > 0 && buf[n - 1] == '\n')
+        --n;
+    buf[n] = '\0';
+    return 1;
+}
+
+static int serveFindField(const char* text, const char* name, char* dst, size_t size) {
+    const size_t nameN = strlen(name);
+    const char* line;
+    size_t n;
+
+    for(line = text; line != NULL; line = strchr(line, '\n')) {
+        if(line[0] == '\n')
+            ++line;
+        if(strncmp(line, name, nameN) != 0 || line[nameN] != '=')
+            continue;
+
+        line += nameN + 1;
+        for(n = 0; n < size - 1 && line[n] != '\0' && line[n] != '\n'; ++n)
+            dst[n] = line[n];
+        dst[n] = '\0';
+        return 1;
+    }
+
+    return 0;
+}
+
+static int serveActive(unsigned long* uid, char* session) {
+    char text[1024];
+    char value[SERVE_SESSION_SIZE];
+    char* end;
+    struct stat vtStat;
+
+    session[0] = '\0';
+
+    if(serveActiveSource == SERVE_ACTIVE_SEAT) {
+        /* No ACTIVE_UID means nobody is logged in on the seat */
+        if(!serveReadFile(SERVE_SEAT_PATH, text, sizeof(text)) || !serveFindField(text, "ACTIVE_UID", value, sizeof(value)))
+            return 0;
+        *uid = strtoul(value, &end, 10);
+        if(end == value)
+            return 0;
+
+        serveFindField(text, "ACTIVE", session, SERVE_SESSION_SIZE);
+        return 1;
+    }
+
+    if(serveActiveSource == SERVE_ACTIVE_VT) {
+        /* The active terminal, like "tty2" */
+        if(!serveReadFile(SERVE_VT_PATH, value, sizeof(value)) || value[0] == '\0' || strchr(value, '/') != NULL)
+            return 0;
+
+        strcpy(text, "/dev/");
+        strcat(text, value);
+        if(stat(text, &vtStat) < 0)
+            return 0;
+        *uid = (unsigned long)vtStat.st_uid;
+        return 1;
+    }
+
+    return 0;
+}
+
+static int serveIsActive(const struct serveClient* client, unsigned long activeUid, const char* activeSession) {
+    if(client->uid != activeUid)
+        return 0;
+
+    return client->session[0] == '\0' || activeSession[0] == '\0' || strcmp(client->session, activeSession) == 0;
+}
+
+int serveListen(const char* path) {
+    struct sockaddr_un address;
+    struct stat pathStat;
+    mode_t mask;
+    int fd;
+    size_t n;
+
+    for(n = 0; n < BABYBINDS_SERVE_CLIENTS; ++n)
+        serveClients[n].fd = -1;
+
+    /* Triggers only go to executors of the active session. Without a way to find it, they go to every executor */
+    if(access(SERVE_SEAT_PATH, R_OK) == 0)
+        serveActiveSource = SERVE_ACTIVE_SEAT;
+    else if(access(SERVE_VT_PATH, R_OK) == 0)
+        serveActiveSource = SERVE_ACTIVE_VT;
+    else
+        taggedMsg(TM_warning | TM_flush | TM_newline, "No seat or virtual terminal to find the active session: every executor gets its binds, whoever is at the keyboard");
+
+    if(strlen(path) >= sizeof(address.sun_path)) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Socket path is too long: ", (char*)path);
+        return 0;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    /* A socket file nobody listens on is left over from a reader that didn't shut down. Anything else is not replaced */
+    if(lstat(path, &pathStat) == 0 && S_ISSOCK(pathStat.st_mode)) {
+        fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if(fd > -1 && connect(fd, (struct sockaddr*)&address, sizeof(address)) == 0) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Another reader is already listening on: ", (char*)path);
+            close(fd);
+            return 0;
+        }
+        if(fd > -1)
+            close(fd);
+        unlink(path);
+    }
+
+    servePath = salloc(NULL, strlen(path) + 1);
+    if(salloc_f())
+        return 0;
+    strcpy(servePath, path);
+
+    serveListenFD = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(serveListenFD < 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not create socket: ", strerror(errno));
+        return 0;
+    }
+
+    /* Created with mode 0660 right away, so nobody else can connect in between */
+    mask = umask(0117);
+    if(bind(serveListenFD, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        umask(mask);
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not bind socket: ", strerror(errno));
+        return 0;
+    }
+    umask(mask);
+    serveSocketOwner = getpid();
+
+    if(listen(serveListenFD, BABYBINDS_SERVE_CLIENTS) < 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not listen on socket: ", strerror(errno));
+        return 0;
+    }
+
+    serveDeadlineFD = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(serveDeadlineFD < 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not create registration deadline timer: ", strerror(errno));
+        return 0;
+    }
+
+    return loopAdd(serveDeadlineFD, LK_deadline, 0, serveDeadlineBuf, sizeof(serveDeadlineBuf)) && loopAddListener(serveListenFD, LK_listen, 0);
+}
+
+void serveAccept(const struct loopCompletion* completion) {
+    const int fd = (int)completion->result;
+    struct serveClient* client;
+    struct ucred credentials;
+    socklen_t credentialsSize = sizeof(credentials);
+    struct timespec now;
+    char path[64];
+    size_t userClients = 0;
+    size_t n;
+
+    if(completion->result < 0) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not accept executor: ", strerror((int)-completion->result));
+        return;
+    }
+
+    for(n = 0; n < BABYBINDS_SERVE_CLIENTS; ++n) {
+        if(serveClients[n].fd < 0)
+            break;
+    }
+
+    if(n == BABYBINDS_SERVE_CLIENTS || getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &credentialsSize) < 0) {
+        taggedMsg(TM_warning | TM_flush | TM_newline, "Too many executors (or unknown user), refusing one");
+        close(fd);
+        return;
+    }
+
+    for(n = 0; n < BABYBINDS_SERVE_CLIENTS; ++n) {
+        if(serveClients[n].fd > -1 && serveClients[n].uid == (unsigned long)credentials.uid)
+            ++userClients;
+    }
+
+    if(userClients >= BABYBINDS_SERVE_USER_CLIENTS) {
+        taggedMsgf(TM_warning | TM_flush | TM_newline, "Too many executors of uid %lu, refusing one", (unsigned long)credentials.uid);
+        close(fd);
+        return;
+    }
+
+    if(clock_gettime(CLOCK_MONOTONIC, &now) < 0) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not read the clock, refusing executor: ", strerror(errno));
+        close(fd);
+        return;
+    }
+
+    for(n = 0; n < BABYBINDS_SERVE_CLIENTS; ++n) {
+        if(serveClients[n].fd < 0)
+            break;
+    }
+
+    client = &serveClients[n];
+    memset(client, 0, sizeof(struct serveClient));
+    client->fd = fd;
+    client->uid = (unsigned long)credentials.uid;
+    client->deadline = now.tv_sec + BABYBINDS_SERVE_DEADLINE;
+    client->scopes = NULL;
+
+    /* Its session, to tell it from other sessions of the same user (4294967295 is no session) */
+    sprintf(path, "/proc/%lu/sessionid", (unsigned long)credentials.pid);
+    if(!serveReadFile(path, client->session, sizeof(client->session)) || strcmp(client->session, "4294967295") == 0)
+        client->session[0] = '\0';
+
+    if(!loopAdd(fd, LK_executor, n, &client->buf, sizeof(client->buf))) {
+        close(fd);
+        client->fd = -1;
+        return;
+    }
+
+    serveArmDeadline();
+}
+
+void serveHandle(const struct loopCompletion* completion) {
+    struct serveClient* client = &serveClients[completion->index];
+
+    if(client->fd < 0)
+        return;
+
+    /* Registrations and disconnections add and free binds. They only happen at log-ins and log-outs, so allocating is fine */
+    sallocUnlock();
+    if(completion->result <= 0 || !serveRegister(client, (size_t)completion->result))
+        serveDisconnect(client);
+    sallocLock();
+}
+
+void serveExpire(void) {
+    struct timespec now;
+    size_t n;
+
+    if(clock_gettime(CLOCK_MONOTONIC, &now) < 0) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not read the clock for registration deadlines: ", strerror(errno));
+        return;
+    }
+
+    /* Like serveHandle, disconnecting frees memory */
+    sallocUnlock();
+    for(n = 0; n < BABYBINDS_SERVE_CLIENTS; ++n) {
+        if(serveClients[n].fd > -1 && !serveClients[n].registered && serveClients[n].deadline <= now.tv_sec) {
+            taggedMsgf(TM_warning | TM_flush | TM_newline, "Executor of uid %lu didn't finish registering in time, disconnecting it", serveClients[n].uid);
+            serveDisconnect(&serveClients[n]);
+        }
+    }
+    sallocLock();
+
+    serveArmDeadline();
+}
+
+int serveIsBind(size_t bind) {
+    return bind < serveOwnersN && serveOwners[bind].client >= 0;
+}
+
+void serveTrigger(size_t bind, const struct input_event* ev, const char* device) {
+    struct serveTrigger trigger;
+    const char* separator = " ";
+    char activeSession[SERVE_SESSION_SIZE];
+    unsigned long activeUid = 0;
+    int hasActive;
+    long owned;
+    size_t n;
+
+    memset(&trigger, 0, sizeof(trigger));
+    trigger.ev = *ev;
+    for(n = 0; n < BABYBINDS_SERVE_NAME - 1 && device[n] != '\0'; ++n)
+        trigger.device[n] = device[n];
+
+    /* Keys only go to whoever is at the keyboard. If that can't be found right now, nobody gets them */
+    hasActive = serveActive(&activeUid, activeSession);
+
+    /* This bind and the same one of every other executor */
+    fputs("sent to executors:", stdout);
+    for(owned = (long)bind; owned >= 0; owned = serveOwners[owned].next) {
+        const struct serveClient* client = &serveClients[serveOwners[owned].client];
+
+        /* Its binds are matched as they come, but it only waits for triggers once it got the reply */
+        if(!client->registered)
+            continue;
+
+        trigger.bind = serveOwners[owned].bind;
+        printf("%suid %lu (its bind %lu)", separator, client->uid, trigger.bind);
+        separator = ", ";
+
+        if(serveActiveSource != SERVE_ACTIVE_NONE && (!hasActive || !serveIsActive(client, activeUid, activeSession))) {
+            fputs(" (not sent: not the active session)", stdout);
+            continue;
+        }
+
+        /* Never wait for an executor */
+        if(send(client->fd, &trigger, sizeof(trigger), MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)sizeof(trigger))
+            printf(" (dropped: %s)", strerror(errno));
+    }
+    putchar('\n');
+    fflush(stdout);
+}
+
+int serveConnect(const char* path) {
+    struct sockaddr_un address;
+    struct serveHello hello;
+    size_t n;
+
+    if(strlen(path) >= sizeof(address.sun_path)) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Socket path is too long: ", (char*)path);
+        return 0;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    serveReaderFD = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if(serveReaderFD < 0 || connect(serveReaderFD, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not connect to reader: ", strerror(errno));
+        return 0;
+    }
+
+    /* Register: hello, scope names and binds. Sends block, as the reader reads them as they come */
+    memset(&hello, 0, sizeof(hello));
+    hello.version = SERVE_VERSION;
+    hello.comboBufferSize = BABYBINDS_COMBOBUFFER_SIZE;
+    hello.scopeNum = (unsigned long)scopeNum;
+    hello.bindNum = (unsigned long)bindNum;
+    if(send(serveReaderFD, &hello, sizeof(hello), MSG_NOSIGNAL) != (ssize_t)sizeof(hello)) {
+        taggedMsg2(TM_error | TM_flush | TM_newline, "Could not register with reader: ", strerror(errno));
+        return 0;
+    }
+
+    for(n = 0; n < scopeNum; ++n) {
+        if(strlen(scopeNames[n]) >= BABYBINDS_SERVE_NAME) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Device label or group is too long for a reader: ", scopeNames[n]);
+            return 0;
+        }
+
+        if(send(serveReaderFD, scopeNames[n], strlen(scopeNames[n]), MSG_NOSIGNAL) != (ssize_t)strlen(scopeNames[n])) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Could not register with reader: ", strerror(errno));
+            return 0;
+        }
+    }
+
+    for(n = 0; n < bindNum; ++n) {
+        struct serveBind bind;
+
+        memset(&bind, 0, sizeof(bind));
+        bind.scope = (unsigned long)comboBinds[n].scope;
+        bind.size = (unsigned long)comboBinds[n].size;
+        memcpy(bind.codes, comboBinds[n].codes, sizeof(int) * comboBinds[n].size);
+        if(send(serveReaderFD, &bind, sizeof(bind), MSG_NOSIGNAL) != (ssize_t)sizeof(bind)) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Could not register with reader: ", strerror(errno));
+            return 0;
+        }
+    }
+
+    /* The reply says it is done (the reader closes the socket if it rejects the binds) */
+    if(recv(serveReaderFD, &hello, sizeof(hello), 0) != (ssize_t)sizeof(hello) || hello.version != SERVE_VERSION) {
+        taggedMsg(TM_error | TM_flush | TM_newline, "The reader rejected the binds (another version of babybinds, or too many binds: see the reader's log)");
+        return 0;
+    }
+
+    /* Timestamps come from the reader's devices */
+    deviceSetClock((int)hello.clock);
+
+    return loopAdd(serveReaderFD, LK_reader, 0, &serveIncoming, sizeof(serveIncoming));
+}
+
+int serveReceive(const struct loopCompletion* completion) {
+    if(completion->result <= 0)
+        return 0;
+
+    if(completion->result != (long)sizeof(struct serveTrigger) || serveIncoming.bind >= bindNum) {
+        taggedMsg(TM_warning | TM_flush | TM_newline, "Invalid trigger from reader, ignoring");
+        return 1;
+    }
+
+    serveIncoming.device[BABYBINDS_SERVE_NAME - 1] = '\0';
+    triggerBind((size_t)serveIncoming.bind, "Bind triggered by the reader: ", &serveIncoming.ev, serveIncoming.device);
+    return 1;
+}
+
+void serveShutdown(void) {
+    size_t n;
+
+    if(serveReaderFD > -1)
+        close(serveReaderFD);
+    serveReaderFD = -1;
+
+    if(serveListenFD < 0 && servePath == NULL)
+        return;
+
+    for(n = 0; n < BABYBINDS_SERVE_CLIENTS; ++n) {
+        if(serveClients[n].fd > -1)
+            close(serveClients[n].fd);
+        if(serveClients[n].fd > -1 && serveClients[n].scopes != NULL)
+            sfree(serveClients[n].scopes);
+        serveClients[n].fd = -1;
+    }
+
+    if(serveListenFD > -1)
+        close(serveListenFD);
+    serveListenFD = -1;
+
+    if(serveDeadlineFD > -1)
+        close(serveDeadlineFD);
+    serveDeadlineFD = -1;
+
+    if(servePath != NULL) {
+        if(getpid() == serveSocketOwner)
+            unlink(servePath);
+        servePath = sfree(servePath);
+    }
+
+    if(serveOwners != NULL)
+        serveOwners = sfree(serveOwners);
+    serveOwnersN = 0;
+}
@@ -0,0 +1,106 @@
+#ifndef BABYBINDS_SERVE_H
+#define BABYBINDS_SERVE_H
+
+/***** All stuff related to sharing input devices between users (a reader and its executors) *****/
+/* For datatypes */
+#include "datatypes.h"
+
+/* For bind globals and compile time settings */
+#include "globals.h"
+
+/* For memory management */
+#include "memory.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* For device names, views and the clock of event timestamps */
+#include "device.h"
+
+/* For watching the sockets */
+#include "eventloop.h"
+
+/* For input_event */
+#include <linux/input.h>
+
+/* Instead of one babybinds per user, each opening and matching the same devices, a single reader owns the devices and
+ * executors (one per user session, running as that user) register their binds with it over a unix socket:
+ * - The reader (--serve <socket>) loads no config of its own. It adds the binds of every executor to its bind tables,
+ *   so they are all matched together, once per event, and sends the number of a triggered bind to the executor that owns it
+ *   (to every executor that has it, if several have the same combo in the same scope). As they are one table, a combo of an
+ *   executor that is part of a longer combo of another executor also waits for the longer one (see --overlap-window)
+ *   Sends never block the reader: a trigger for an executor that doesn't keep up is dropped with a warning
+ * - An executor (--executor <socket>) loads its config, opens no device and matches nothing. It executes the binds the reader
+ *   sends it (commands, plugins, templates and output capture work as usual), as the user that started it
+ * The binds of an executor are dropped when it disconnects. The reader's compiled matcher is not used, as binds come and go
+ * An executor that hasn't finished registering BABYBINDS_SERVE_DEADLINE seconds after connecting is disconnected, and a user
+ * can only have BABYBINDS_SERVE_USER_CLIENTS executors connected. Binds count against BABYBINDS_SERVE_TOTAL_BINDS as they arrive
+ * Triggers only go to executors of the active session: the user (and session, if both ends have one) logind says is active
+ * on seat0, or else the owner of the active virtual terminal. If neither can be found at start-up, every executor gets them
+ * The socket is created with mode 0660, so only its owner and group can register (give the group to the users of the
+ * workstation, or put the socket in a directory only they can reach)
+ * Messages are SOCK_SEQPACKET packets of these structs (executors are babybinds too, so both ends are the same build):
+ *   executor -> reader: serveHello, then scopeNum scope names (bytes, without null terminator), then bindNum serveBind
+ *   reader -> executor: serveHello (the registration is accepted), then a serveTrigger per triggered bind */
+
+/* Start of a registration, and its reply */
+struct serveHello {
+    /* SERVE_VERSION and BABYBINDS_COMBOBUFFER_SIZE of the sender (they must match) */
+    unsigned long version;
+    unsigned long comboBufferSize;
+    /* Number of scope names and binds that follow */
+    unsigned long scopeNum;
+    unsigned long bindNum;
+    /* Reply only: clock of the reader's event timestamps */
+    long clock;
+};
+
+/* A bind of an executor (its bind number is its position in the registration) */
+struct serveBind {
+    /* Scope, as in keyCombo.scope: 0 for any device, or n for the nth scope name of the registration */
+    unsigned long scope;
+    /* Keycodes */
+    unsigned long size;
+    int codes[BABYBINDS_COMBOBUFFER_SIZE];
+};
+
+/* A triggered bind of an executor */
+struct serveTrigger {
+    /* Bind number of the executor */
+    unsigned long bind;
+    /* Event that triggered it and the name of its device */
+    struct input_event ev;
+    char device[BABYBINDS_SERVE_NAME];
+};
+
+/*** Reader ***/
+/* Listens for executors on a unix socket (a stale socket file is replaced). Returns 1 on success, 0 on failure */
+int serveListen(const char* path);
+
+/* Takes in an executor from an LK_listen completion */
+void serveAccept(const struct loopCompletion* completion);
+
+/* Handles an LK_executor completion: the next step of a registration, or a disconnection (which drops its binds) */
+void serveHandle(const struct loopCompletion* completion);
+
+/* Disconnects the executors whose registration deadline has passed (on LK_deadline completions) */
+void serveExpire(void);
+
+/* Returns 1 if a bind belongs to an executor, 0 if not */
+int serveIsBind(size_t bind);
+
+/* Sends a triggered bind to its executor, with the event that triggered it and the name of its device */
+void serveTrigger(size_t bind, const struct input_event* ev, const char* device);
+
+/*** Executor ***/
+/* Connects to a reader and registers the loaded binds. Waits for the reply, so it is done when this returns
+   Returns 1 on success, 0 on failure (prints an error message) */
+int serveConnect(const char* path);
+
+/* Handles an LK_reader completion, triggering the bind it names. Returns 1 on success, 0 if the reader is gone */
+int serveReceive(const struct loopCompletion* completion);
+
+/* Disconnects from the reader or closes the socket and all executors (the socket file is removed) */
+void serveShutdown(void);
+
+#endif
@@ -0,0 +1,214 @@
+/***** status.h implementation *****/
+/* Needed for O_CLOEXEC and clock_gettime */
+#define _GNU_SOURCE
+
+#include "status.h"
+
+/* For errno */
+#include <errno.h>
+#include <string.h>
+
+/* For the shared memory file */
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+/* Mode of the page. It shows the keys held right now, so only the daemon's user and group can read it */
+#define STATUS_MODE 0640
+
+/* The pressed key bits of the page must hold every keycode */
+typedef char statusKeyBytesCheck[(BABYBINDS_STATUS_KEY_BYTES * 8 >= KEY_CNT) ? 1 : -1];
+
+/* Mapped page (NULL if there is none), its size, its trigger counts and its path (to remove it) */
+static volatile struct babybindsStatus* statusPage = NULL;
+static size_t statusSize = 0;
+static volatile unsigned long* statusBinds = NULL;
+static char* statusPath = NULL;
+
+/* Private counts (trigger count of each bind and latencies), copied to the page by statusPublish
+   Trigger counts are only copied if something triggered since the last copy, as there can be many */
+static unsigned long* statusBindCounts = NULL;
+static unsigned long statusLatency[BABYBINDS_STATUS_LATENCY_BUCKETS];
+static unsigned long statusPublishedTriggers = 0;
+
+/* Process that created the page. Children that fail to exec shut down too, and must not remove it */
+static pid_t statusOwner = -1;
+
+/*** Internal functions ***/
+/* Creates the page file: never follows a symlink and never opens a file that already exists, except a page left over by
+   a daemon that is gone, which is replaced. Returns the file descriptor, or -1 on failure (errno is set) */
+static int statusCreate(const char* path);
+
+/*** Implementations ***/
+static int statusCreate(const char* path) {
+    struct babybindsStatus old;
+    struct stat pathStat;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, STATUS_MODE);
+    if(fd > -1 || errno != EEXIST)
+        return fd;
+
+    /* Something is there. Only a regular file that is the page of a dead daemon (or an empty one, from a daemon that died
+       making it) is replaced. Removing a symlink only removes the link, so nothing it points to is touched */
+    if(lstat(path, &pathStat) < 0 || !S_ISREG(pathStat.st_mode)) {
+        errno = EEXIST;
+        return -1;
+    }
+
+    if(pathStat.st_size > 0) {
+        fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+        if(fd < 0)
+            return -1;
+        if(read(fd, &old, sizeof(old)) != (ssize_t)sizeof(old) || old.magic != BABYBINDS_STATUS_MAGIC
+            || (old.pid != (unsigned long)getpid() && (kill((pid_t)old.pid, 0) == 0 || errno == EPERM))) {
+            close(fd);
+            errno = EEXIST;
+            return -1;
+        }
+        close(fd);
+    }
+
+    if(unlink(path) < 0)
+        return -1;
+
+    return open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, STATUS_MODE);
+}
+
+void statusInit(const char* path) {
+    const char* shmPrefix = "/dev/shm/babybinds.";
+    int fd;
+
+    /* Default path (prefix + up to 20 digits of pid + null-terminator) */
+    statusPath = salloc(NULL, path == NULL ? strlen(shmPrefix) + 21 : strlen(path) + 1);
+    if(salloc_f())
+        return;
+
+    if(path == NULL)
+        sprintf(statusPath, "%s%lu", shmPrefix, (unsigned long)getpid());
+    else
+        strcpy(statusPath, path);
+
+    fd = statusCreate(statusPath);
+    if(fd < 0) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not create status page, not publishing status: ", strerror(errno));
+        statusPath = sfree(statusPath);
+        return;
+    }
+
+    if(bindNum > 0) {
+        statusBindCounts = salloc(NULL, sizeof(unsigned long) * bindNum);
+        if(salloc_f()) {
+            close(fd);
+            unlink(statusPath);
+            statusPath = sfree(statusPath);
+            return;
+        }
+        memset(statusBindCounts, 0, sizeof(unsigned long) * bindNum);
+    }
+
+    statusSize = sizeof(struct babybindsStatus) + sizeof(unsigned long) * bindNum;
+    if(ftruncate(fd, (off_t)statusSize) < 0) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not size status page, not publishing status: ", strerror(errno));
+        close(fd);
+        unlink(statusPath);
+        statusPath = sfree(statusPath);
+        return;
+    }
+
+    /* The mapping keeps the file alive, the descriptor is not needed anymore. The file is zero-filled by ftruncate */
+    statusPage = mmap(NULL, statusSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(statusPage == MAP_FAILED) {
+        taggedMsg2(TM_warning | TM_flush | TM_newline, "Could not map status page, not publishing status: ", strerror(errno));
+        statusPage = NULL;
+        unlink(statusPath);
+        statusPath = sfree(statusPath);
+        return;
+    }
+
+    statusOwner = getpid();
+    statusBinds = (volatile unsigned long*)(statusPage + 1);
+    statusPage->pid = (unsigned long)getpid();
+    statusPage->bindNum = (unsigned long)bindNum;
+    statusPage->version = BABYBINDS_STATUS_VERSION;
+
+    /* The magic goes last, so readers never take a half-initialized page for a valid one */
+    __sync_synchronize();
+    statusPage->magic = BABYBINDS_STATUS_MAGIC;
+}
+
+void statusPublish(void) {
+    unsigned char pressed[BABYBINDS_STATUS_KEY_BYTES];
+    const int copyBinds = stats.triggers != statusPublishedTriggers;
+    size_t n;
+
+    if(statusPage == NULL)
+        return;
+
+    /* Everything that takes any work is done before the section */
+    devicePressed(pressed, sizeof(pressed));
+
+    ++statusPage->seq;
+    __sync_synchronize();
+
+    statusPage->events = stats.events;
+    statusPage->keyEvents = stats.keyEvents;
+    statusPage->debounced = stats.debounced;
+    statusPage->triggers = stats.triggers;
+    memcpy((void*)statusPage->latency, statusLatency, sizeof(statusLatency));
+    memcpy((void*)statusPage->pressed, pressed, sizeof(pressed));
+    if(copyBinds) {
+        for(n = 0; n < statusPage->bindNum; ++n)
+            statusBinds[n] = statusBindCounts[n];
+    }
+
+    __sync_synchronize();
+    ++statusPage->seq;
+
+    statusPublishedTriggers = stats.triggers;
+}
+
+void statusTrigger(size_t bind, const struct timeval* time) {
+    struct timespec now;
+    long latency;
+    size_t bucket;
+
+    if(statusPage == NULL)
+        return;
+
+    /* Binds added after the page was made (by executors, see serve.h) have no trigger count */
+    if(bind < statusPage->bindNum)
+        ++statusBindCounts[bind];
+
+    /* Latency in microseconds, into its power of 2 bucket (clock jumps can make it negative, that counts as 0) */
+    if(clock_gettime(deviceClock(), &now) < 0)
+        return;
+
+    latency = (long)(now.tv_sec - time->tv_sec) * 1000000 + (now.tv_nsec / 1000 - (long)time->tv_usec);
+    for(bucket = 0; bucket < BABYBINDS_STATUS_LATENCY_BUCKETS - 1 && latency >= 2; ++bucket)
+        latency /= 2;
+
+    ++statusLatency[bucket];
+}
+
+void statusShutdown(void) {
+    if(statusPage != NULL)
+        munmap((void*)statusPage, statusSize);
+
+    if(statusPath != NULL) {
+        if(getpid() == statusOwner)
+            unlink(statusPath);
+        statusPath = sfree(statusPath);
+    }
+
+    if(statusBindCounts != NULL)
+        statusBindCounts = sfree(statusBindCounts);
+
+    statusPage = NULL;
+    statusBinds = NULL;
+    statusSize = 0;
+}
@@ -0,0 +1,41 @@
+#ifndef BABYBINDS_STATUS_H
+#define BABYBINDS_STATUS_H
+
+/***** All stuff related to publishing the status page for monitors *****/
+/* For the page layout */
+#include "babybinds_status.h"
+
+/* For the stats and bind globals */
+#include "globals.h"
+
+/* For memory management */
+#include "memory.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* For the pressed keys and the clock of event timestamps */
+#include "device.h"
+
+/* For struct timeval */
+#include <sys/time.h>
+
+/* The daemon counts privately, and publishes a copy of its counters to the page at the end of each event loop wakeup, in
+ * an update section (an odd seqlock sequence number, see babybinds_status.h). The section is only the copy, never any
+ * syscall or command, so readers never wait long. The page costs two barriers and a short copy per wakeup, and readers
+ * see the state between wakeups */
+
+/* Creates the status page (after the config is loaded, as it has a trigger count per bind)
+   If path is NULL, /dev/shm/babybinds.<pid> is used. Failing to create it is only a warning */
+void statusInit(const char* path);
+
+/* Copies the stats, trigger counts, latencies and pressed keys to the page in an update section */
+void statusPublish(void);
+
+/* Counts a triggered bind and its latency (from the kernel timestamp of the event that triggered it), until the next publish */
+void statusTrigger(size_t bind, const struct timeval* time);
+
+/* Removes the status page */
+void statusShutdown(void);
+
+#endif
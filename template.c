@@ -0,0 +1,232 @@
+/***** template.h implementation *****/
+#include "template.h"
+
+/* For strstr and memcpy */
+#include <string.h>
+
+/* Room reserved for numbers: an unsigned long has at most 20 digits */
+#define TEMPLATE_NUMBER_SIZE 20
+
+/* Placeholder names and what they are filled in with */
+static const struct {
+    const char* name;
+    enum templateHole hole;
+} templateHoles[] = {
+    { "keycode", TH_keycode },
+    { "time",    TH_time    },
+    { "device",  TH_device  },
+    { "count",   TH_count   }
+};
+
+/*** Internal functions ***/
+/* Appends a slice to a template, adding its room to the buffer size. Returns 1 on success, 0 on failure (out of memory) */
+static int templateAddSlice(struct templateExec* tmpl, size_t arg, enum templateHole hole, const char* text, size_t size);
+
+/* Compiles one argument of a command into slices. Returns 1 on success, 0 on failure (prints an error message) */
+static int templateCompileArg(struct templateExec* tmpl, const char* argument, size_t arg);
+
+/* Writes a number in decimal, zero-padded to at least minDigits digits. Returns the end of what was written */
+static char* templateWriteNumber(char* out, unsigned long value, size_t minDigits);
+
+/*** Implementations ***/
+static int templateAddSlice(struct templateExec* tmpl, size_t arg, enum templateHole hole, const char* text, size_t size) {
+    tmpl->slices = salloc(tmpl->slices, sizeof(struct templateSlice) * (tmpl->sliceNum + 1));
+    if(salloc_f())
+        return 0; /* Out of memory! */
+
+    tmpl->slices[tmpl->sliceNum].arg = arg;
+    tmpl->slices[tmpl->sliceNum].hole = hole;
+    tmpl->slices[tmpl->sliceNum].text = text;
+    tmpl->slices[tmpl->sliceNum].size = size;
+    ++tmpl->sliceNum;
+
+    tmpl->bufferSize += size;
+    return 1;
+}
+
+static int templateCompileArg(struct templateExec* tmpl, const char* argument, size_t arg) {
+    const char* start = argument;
+    const char* c = argument;
+
+    while((c = strstr(c, "%{")) != NULL) {
+        const char* end;
+        size_t n;
+
+        /* %%{ is a literal %{: the literal goes on up to the first %, and starts again at the { */
+        if(c > start && c[-1] == '%') {
+            if(!templateAddSlice(tmpl, arg, TH_literal, start, (size_t)(c - start)))
+                return 0;
+            start = c + 1;
+            c += 2;
+            continue;
+        }
+
+        end = strchr(c + 2, '}');
+        if(end == NULL) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Malformed configuration file: Unterminated placeholder in argument: ", (char*)argument);
+            return 0;
+        }
+
+        for(n = 0; n < sizeof(templateHoles) / sizeof(templateHoles[0]); ++n) {
+            if(strlen(templateHoles[n].name) == (size_t)(end - c - 2) && memcmp(templateHoles[n].name, c + 2, (size_t)(end - c - 2)) == 0)
+                break;
+        }
+        if(n == sizeof(templateHoles) / sizeof(templateHoles[0])) {
+            taggedMsg2(TM_error | TM_flush | TM_newline, "Malformed configuration file: Unknown placeholder in argument: ", (char*)argument);
+            return 0;
+        }
+
+        /* Literal before the placeholder, if any */
+        if(c > start && !templateAddSlice(tmpl, arg, TH_literal, start, (size_t)(c - start)))
+            return 0;
+
+        /* Room for the hole: a number, a timestamp (seconds, a dot and 6 digits of microseconds) or the longest device name
+           Without devices (executors), device names come from a reader, which cuts them to BABYBINDS_SERVE_NAME */
+        if(templateHoles[n].hole == TH_device) {
+            size_t device;
+            size_t room = (deviceCount() == 0) ? BABYBINDS_SERVE_NAME - 1 : 0;
+
+            for(device = 0; device < deviceCount(); ++device) {
+                if(strlen(deviceName(device)) > room)
+                    room = strlen(deviceName(device));
+            }
+
+            if(!templateAddSlice(tmpl, arg, TH_device, NULL, room))
+                return 0;
+        }
+        else if(!templateAddSlice(tmpl, arg, templateHoles[n].hole, NULL, TEMPLATE_NUMBER_SIZE + (templateHoles[n].hole == TH_time ? 7 : 0)))
+            return 0;
+
+        start = c = end + 1;
+    }
+
+    /* Rest of the argument (every templated argument has at least one slice, as it has a %{) */
+    if(*start != '\0' && !templateAddSlice(tmpl, arg, TH_literal, start, strlen(start)))
+        return 0;
+
+    /* Null terminator */
+    ++tmpl->bufferSize;
+    return 1;
+}
+
+static char* templateWriteNumber(char* out, unsigned long value, size_t minDigits) {
+    char digits[TEMPLATE_NUMBER_SIZE];
+    size_t digitsN = 0;
+
+    /* Digits come out backwards */
+    do {
+        digits[digitsN++] = (char)('0' + value % 10);
+        value /= 10;
+    } while(value > 0 || digitsN < minDigits);
+
+    while(digitsN > 0)
+        *out++ = digits[--digitsN];
+
+    return out;
+}
+
+int templateCompile(struct keyExec* exec) {
+    struct templateExec* tmpl;
+    size_t arg;
+
+    /* Only commands with placeholders (or escaped ones) get a template */
+    for(arg = 0; exec->elems[arg] != NULL; ++arg) {
+        if(strstr(exec->elems[arg], "%{") != NULL)
+            break;
+    }
+    if(exec->elems[arg] == NULL)
+        return 1;
+
+    tmpl = salloc(NULL, sizeof(struct templateExec));
+    if(salloc_f())
+        return 0; /* Out of memory! */
+
+    tmpl->slices = NULL;
+    tmpl->sliceNum = 0;
+    tmpl->argv = NULL;
+    tmpl->buffer = NULL;
+    tmpl->bufferSize = 0;
+    tmpl->count = 0;
+    exec->tmpl = tmpl;
+
+    /* The argv starts as a copy of elems. Templated arguments are pointed into the buffer on every expansion */
+    tmpl->argv = salloc(NULL, sizeof(char*) * exec->size);
+    if(salloc_f())
+        return 0; /* Out of memory! */
+    memcpy(tmpl->argv, exec->elems, sizeof(char*) * exec->size);
+
+    for(; exec->elems[arg] != NULL; ++arg) {
+        if(strstr(exec->elems[arg], "%{") != NULL && !templateCompileArg(tmpl, exec->elems[arg], arg))
+            return 0;
+    }
+
+    tmpl->buffer = salloc(NULL, tmpl->bufferSize);
+    if(salloc_f())
+        return 0; /* Out of memory! */
+
+    return 1;
+}
+
+char** templateExpand(struct keyExec* exec, const struct input_event* ev, const char* device) {
+    struct templateExec* tmpl = exec->tmpl;
+    char* out;
+    size_t n;
+
+    if(tmpl == NULL)
+        return exec->elems;
+
+    ++tmpl->count;
+    out = tmpl->buffer;
+    for(n = 0; n < tmpl->sliceNum; ++n) {
+        const struct templateSlice* slice = &tmpl->slices[n];
+
+        /* First slice of an argument: terminate the previous argument and start this one */
+        if(n == 0 || slice->arg != tmpl->slices[n - 1].arg) {
+            if(n > 0)
+                *out++ = '\0';
+            tmpl->argv[slice->arg] = out;
+        }
+
+        switch(slice->hole) {
+        case TH_literal:
+            memcpy(out, slice->text, slice->size);
+            out += slice->size;
+            break;
+        case TH_keycode:
+            out = templateWriteNumber(out, (unsigned long)ev->code, 1);
+            break;
+        case TH_time:
+            out = templateWriteNumber(out, (unsigned long)ev->time.tv_sec, 1);
+            *out++ = '.';
+            out = templateWriteNumber(out, (unsigned long)ev->time.tv_usec, 6);
+            break;
+        case TH_device: {
+            /* Never longer than its room, although no device is added after the config is loaded */
+            const size_t size = strlen(device) < slice->size ? strlen(device) : slice->size;
+
+            memcpy(out, device, size);
+            out += size;
+            break;
+        }
+        case TH_count:
+            out = templateWriteNumber(out, tmpl->count, 1);
+            break;
+        }
+    }
+    *out = '\0';
+
+    return tmpl->argv;
+}
+
+void templateFree(struct keyExec* exec) {
+    if(exec->tmpl == NULL)
+        return;
+
+    if(exec->tmpl->slices != NULL)
+        sfree(exec->tmpl->slices);
+    if(exec->tmpl->argv != NULL)
+        sfree(exec->tmpl->argv);
+    if(exec->tmpl->buffer != NULL)
+        sfree(exec->tmpl->buffer);
+    exec->tmpl = sfree(exec->tmpl);
+}
@@ -0,0 +1,39 @@
+#ifndef BABYBINDS_TEMPLATE_H
+#define BABYBINDS_TEMPLATE_H
+
+/***** All stuff related to argument templates (placeholders in bind commands) *****/
+/* For datatypes */
+#include "datatypes.h"
+
+/* For memory management */
+#include "memory.h"
+
+/* For error messages */
+#include "printmsgs.h"
+
+/* For the names of input devices */
+#include "device.h"
+
+/* For input_event */
+#include <linux/input.h>
+
+/* Arguments of a command can have placeholders, filled in with the event that triggered the bind:
+ *   %{keycode} %{time} %{device} %{count} (see enum templateHole), and %%{ for a literal %{
+ * so one bind can serve several keys or devices instead of a copy of it with a hardcoded argument each
+ * When the bind is added, its arguments are compiled once into slices of literal text and holes, and an argv and an
+ * expansion buffer sized for the longest expansion are allocated. Triggering only copies slices into that buffer:
+ * no parsing and no allocations on the event path. Arguments without placeholders are never copied */
+
+/* Compiles the command of a bind into a template (exec->tmpl), if it has placeholders. Commands without them are left alone
+   Devices must be opened before, as %{device} reserves room for the longest device name (or the longest a reader sends)
+   Returns 1 on success, 0 on failure (unknown placeholder or out of memory, prints an error message) */
+int templateCompile(struct keyExec* exec);
+
+/* Fills in the template of a bind with the event that triggered it and the name of the device it came from
+   Returns the argv to execute (the command's elems if it has no template). It is overwritten by the next expansion */
+char** templateExpand(struct keyExec* exec, const struct input_event* ev, const char* device);
+
+/* Frees the template of a bind, if it has one */
+void templateFree(struct keyExec* exec);
+
+#endif
@@ -0,0 +1,73 @@
+#!/bin/sh
+# allocguard: checks that the event path of babybinds never allocates memory
+# Usage: tools/allocguard.sh [trace]
+# Builds babybinds with -DBABYBINDS_ALLOC_GUARD (it aborts on any allocation after start-up) and replays a trace of input
+# events through a FIFO device, with a config that triggers every kind of bind. The trace is raw struct input_event
+# records, like a recording of an input device (cat /dev/input/eventN > trace). Without one, tools/tracegen.c makes one
+# Exits with 0 if the whole trace was replayed without allocations, 1 if not
+
+# Taps of the generated trace
+TAPS=50000
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d) || exit 1
+trap 'rm -rf "$work"' EXIT
+
+fail() {
+    echo "[FAIL] $1"
+    [ -f "$work/daemon.log" ] && tail -n 20 "$work/daemon.log"
+    exit 1
+}
+
+# Build
+cc -std=c89 -fcommon -O2 -DBABYBINDS_ALLOC_GUARD -o "$work/babybinds" "$root"/*.c -ldl || fail "could not build babybinds"
+
+if [ $# -gt 0 ]; then
+    trace=$1
+else
+    trace=$work/trace
+    cc -O2 -o "$work/tracegen" "$root/tools/tracegen.c" || fail "could not build tracegen"
+    "$work/tracegen" $TAPS > "$trace" || fail "could not generate the trace"
+fi
+
+# Keycodes are the ones of tracegen: single-key, scoped and templated binds, and a combo with a longer one containing it
+cat > "$work/config" <<EOF
+30:true
+[kbd]33:true
+48:true %{keycode} %{device} %{time} %{count}
+29;31:true
+29;31;32:true
+EOF
+
+# The FIFO is opened for reading and writing first, so that neither end blocks until babybinds has it open
+mkfifo "$work/kbd" || fail "could not create the FIFO"
+exec 3<>"$work/kbd"
+"$work/babybinds" -f "$work/config" -o "$work/output.log" -s "$work/status" -d 5 -w 20 kbd="$work/kbd" > "$work/daemon.log" 2>&1 &
+pid=$!
+
+tries=0
+until grep -q "Started!" "$work/daemon.log"; do
+    tries=$((tries + 1))
+    kill -0 $pid 2> /dev/null && [ $tries -lt 100 ] || fail "babybinds did not start"
+    sleep 0.1
+done
+
+# Then only babybinds reads it, so writing stops if it dies
+exec 4>"$work/kbd" 3<&-
+cat "$trace" >&4 2> /dev/null
+sleep 2
+kill -INT $pid 2> /dev/null
+wait $pid
+status=$?
+exec 4>&-
+
+grep -q "Memory allocated or freed after start-up" "$work/daemon.log" && fail "memory was allocated on the event path"
+[ $status -eq 0 ] || fail "babybinds exited with status $status"
+
+# Every event of the trace must have been read (struct input_event is 24 bytes on 64-bit, 16 on 32-bit)
+if [ "$(getconf LONG_BIT)" = 64 ]; then size=24; else size=16; fi
+events=$(($(wc -c < "$trace") / size))
+grep -q "Stats: $events events" "$work/daemon.log" || fail "not all $events events of the trace were replayed"
+
+echo "[OK] $events events replayed without allocations: $(grep "Stats:" "$work/daemon.log")"
+exit 0
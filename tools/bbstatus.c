@@ -0,0 +1,177 @@
+/***** bbstatus: prints the status page of a running babybinds *****/
+/* Build with: cc -O2 -o bbstatus tools/bbstatus.c
+   Usage: bbstatus <pid or status page path> [interval in seconds]
+   With an interval, the status is printed again every interval seconds until interrupted */
+
+/* For the page layout */
+#include "../babybinds_status.h"
+
+/* Standard includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* For mapping the page */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* For checking that the daemon is alive and waiting for it */
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+/* A read is retried right away this many times, then once per millisecond up to STATUS_TRIES times in all (about a second)
+   Updates are a short copy, so a page that stays mid-update that long belongs to a daemon that hangs or was killed in one */
+#define STATUS_SPINS 1000
+#define STATUS_TRIES 2000
+
+/* Waits before the next try of a read. Returns 1 to try again, 0 if the daemon is gone or the tries are used up */
+static int waitStatus(const volatile struct babybindsStatus* page, unsigned long* tries) {
+    static const struct timespec pause = { 0, 1000000 };
+
+    if(++*tries < STATUS_SPINS)
+        return 1;
+    if(*tries >= STATUS_TRIES || (kill((pid_t)page->pid, 0) < 0 && errno == ESRCH))
+        return 0;
+
+    nanosleep(&pause, NULL);
+    return 1;
+}
+
+/* Copies a consistent snapshot of the page (the struct and the first bindsMax trigger counts) without blocking the daemon
+   Returns 1 on success, 0 if the page is not a babybinds status page of this version, -1 if the daemon is gone or stuck
+   in the middle of an update */
+static int readStatus(const volatile struct babybindsStatus* page, struct babybindsStatus* status, unsigned long* binds, size_t bindsMax) {
+    unsigned long tries = 0;
+    unsigned long seq;
+    size_t n;
+
+    if(page->magic != BABYBINDS_STATUS_MAGIC || page->version != BABYBINDS_STATUS_VERSION)
+        return 0;
+
+    for(;;) {
+        /* Wait for the daemon to finish its update (a short copy, unless it died or hangs in it) */
+        while((seq = page->seq) % 2 == 1) {
+            if(!waitStatus(page, &tries))
+                return -1;
+        }
+        __sync_synchronize();
+
+        memcpy(status, (const void*)page, sizeof(struct babybindsStatus));
+        if(bindsMax > status->bindNum)
+            bindsMax = status->bindNum;
+        for(n = 0; n < bindsMax; ++n)
+            binds[n] = ((const volatile unsigned long*)(page + 1))[n];
+
+        __sync_synchronize();
+        if(page->seq == seq)
+            return 1;
+
+        if(!waitStatus(page, &tries))
+            return -1;
+    }
+}
+
+/* Prints a snapshot */
+static void printStatus(const struct babybindsStatus* status, const unsigned long* binds, size_t bindsN) {
+    size_t n;
+
+    printf("pid %lu\n", status->pid);
+    printf("events %lu\nkey events %lu\ndebounced %lu\ntriggers %lu\n", status->events, status->keyEvents, status->debounced, status->triggers);
+
+    printf("pressed");
+    for(n = 0; n < BABYBINDS_STATUS_KEY_BYTES * 8; ++n) {
+        if((status->pressed[n / 8] >> (n % 8)) & 1)
+            printf(" %lu", (unsigned long)n);
+    }
+    putchar('\n');
+
+    for(n = 0; n < bindsN; ++n)
+        printf("bind %lu: %lu\n", (unsigned long)n, binds[n]);
+
+    for(n = 0; n < BABYBINDS_STATUS_LATENCY_BUCKETS; ++n) {
+        if(status->latency[n] > 0)
+            printf("latency < %lu us: %lu\n", 2UL << n, status->latency[n]);
+    }
+
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    const volatile struct babybindsStatus* page;
+    struct babybindsStatus status;
+    unsigned long* binds;
+    size_t bindsN;
+    char path[64];
+    const char* pagePath;
+    struct stat pageStat;
+    int interval;
+    int fd;
+
+    if(argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <pid or status page path> [interval in seconds]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* A pid means the default path */
+    pagePath = argv[1];
+    if(strspn(argv[1], "0123456789") == strlen(argv[1]) && strlen(argv[1]) < 21) {
+        sprintf(path, "/dev/shm/babybinds.%s", argv[1]);
+        pagePath = path;
+    }
+
+    interval = argc == 3 ? atoi(argv[2]) : 0;
+
+    fd = open(pagePath, O_RDONLY);
+    if(fd < 0 || fstat(fd, &pageStat) < 0) {
+        perror("Could not open status page");
+        return EXIT_FAILURE;
+    }
+
+    if((size_t)pageStat.st_size < sizeof(struct babybindsStatus)) {
+        fputs("Not a babybinds status page\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    page = mmap(NULL, (size_t)pageStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(page == MAP_FAILED) {
+        perror("Could not map status page");
+        return EXIT_FAILURE;
+    }
+
+    /* Only the trigger counts that fit in the file are read (the bind number of a page never changes) */
+    bindsN = ((size_t)pageStat.st_size - sizeof(struct babybindsStatus)) / sizeof(unsigned long);
+    binds = malloc(sizeof(unsigned long) * (bindsN + 1));
+    if(binds == NULL) {
+        fputs("Out of memory\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    do {
+        const int result = readStatus(page, &status, binds, bindsN);
+
+        if(result == 0) {
+            fputs("Not a babybinds status page (or another version)\n", stderr);
+            return EXIT_FAILURE;
+        }
+        if(result < 0) {
+            fputs("The daemon is gone or stuck in the middle of an update\n", stderr);
+            return EXIT_FAILURE;
+        }
+
+        if(bindsN > status.bindNum)
+            bindsN = status.bindNum;
+        printStatus(&status, binds, bindsN);
+
+        if(interval > 0) {
+            putchar('\n');
+            sleep((unsigned int)interval);
+        }
+    } while(interval > 0);
+
+    free(binds);
+    return EXIT_SUCCESS;
+}
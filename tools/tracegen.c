@@ -0,0 +1,122 @@
+/***** tracegen: writes a synthetic input event trace, for replaying through babybinds (see allocguard.sh) *****/
+/* Build with: cc -O2 -o tracegen tools/tracegen.c
+   Usage: tracegen <number of taps> > trace
+   The trace is raw struct input_event records, like a recording of an input device (cat /dev/input/eventN > trace)
+   It is the same on every run: mostly unbound keys (with repeats), plus the binds of the config in allocguard.sh
+   (single-key, scoped and templated binds, a combo and a longer combo containing it) and some switch chatter */
+
+/* Standard includes */
+#include <stdio.h>
+#include <stdlib.h>
+
+/* For input_event */
+#include <linux/input.h>
+
+/* Time between reports, and between the bounces of a chattering switch (microseconds) */
+#define TRACE_REPORT_GAP 8000
+#define TRACE_CHATTER_GAP 1000
+
+/* Timestamp of the next report */
+static long traceSec = 1000000;
+static long traceUsec = 0;
+
+/* State of the pseudo-random generator (fixed seed, so every trace is the same) */
+static unsigned long traceSeed = 12345;
+
+/* Returns a pseudo-random number below max */
+static unsigned long traceRandom(unsigned long max) {
+    traceSeed = (traceSeed * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+    return (traceSeed >> 8) % max;
+}
+
+/* Writes an event */
+static void traceEvent(unsigned short type, unsigned short code, int value) {
+    struct input_event ev;
+
+    ev.time.tv_sec = traceSec;
+    ev.time.tv_usec = traceUsec;
+    ev.type = type;
+    ev.code = code;
+    ev.value = value;
+    fwrite(&ev, sizeof(ev), 1, stdout);
+}
+
+/* Writes a report with a single key event, gap microseconds after the previous one */
+static void traceKey(unsigned short code, int value, long gap) {
+    traceUsec += gap;
+    traceSec += traceUsec / 1000000;
+    traceUsec %= 1000000;
+
+    traceEvent(EV_MSC, MSC_SCAN, code);
+    traceEvent(EV_KEY, code, value);
+    traceEvent(EV_SYN, SYN_REPORT, 0);
+}
+
+/* Presses a key, with some repeats */
+static void tracePress(unsigned short code) {
+    unsigned long repeats = traceRandom(8) == 0 ? traceRandom(4) : 0;
+
+    traceKey(code, 1, TRACE_REPORT_GAP);
+    while(repeats-- > 0)
+        traceKey(code, 2, TRACE_REPORT_GAP);
+}
+
+int main(int argc, char** argv) {
+    long taps;
+
+    if(argc != 2 || (taps = atol(argv[1])) <= 0) {
+        fputs("Usage: tracegen <number of taps> > trace\n", stderr);
+        return EXIT_FAILURE;
+    }
+
+    while(taps-- > 0) {
+        const unsigned long kind = traceRandom(100);
+
+        if(kind < 75) { /* Unbound key */
+            const unsigned short code = (unsigned short)(KEY_Q + traceRandom(10));
+
+            tracePress(code);
+            traceKey(code, 0, TRACE_REPORT_GAP);
+        }
+        else if(kind < 80) { /* Unbound key held with a bound one: nothing triggers */
+            tracePress(KEY_LEFTCTRL);
+            tracePress(KEY_Q);
+            traceKey(KEY_Q, 0, TRACE_REPORT_GAP);
+            traceKey(KEY_LEFTCTRL, 0, TRACE_REPORT_GAP);
+        }
+        else if(kind < 85) { /* Single-key bind */
+            tracePress(KEY_A);
+            traceKey(KEY_A, 0, TRACE_REPORT_GAP);
+        }
+        else if(kind < 88) { /* Scoped single-key bind */
+            tracePress(KEY_F);
+            traceKey(KEY_F, 0, TRACE_REPORT_GAP);
+        }
+        else if(kind < 91) { /* Templated single-key bind */
+            tracePress(KEY_B);
+            traceKey(KEY_B, 0, TRACE_REPORT_GAP);
+        }
+        else if(kind < 95) { /* Combo that is part of a longer one (deferred, then triggered by the release) */
+            tracePress(KEY_LEFTCTRL);
+            tracePress(KEY_S);
+            traceKey(KEY_S, 0, TRACE_REPORT_GAP);
+            traceKey(KEY_LEFTCTRL, 0, TRACE_REPORT_GAP);
+        }
+        else if(kind < 98) { /* The longer combo */
+            tracePress(KEY_LEFTCTRL);
+            tracePress(KEY_S);
+            tracePress(KEY_D);
+            traceKey(KEY_D, 0, TRACE_REPORT_GAP);
+            traceKey(KEY_S, 0, TRACE_REPORT_GAP);
+            traceKey(KEY_LEFTCTRL, 0, TRACE_REPORT_GAP);
+        }
+        else { /* Chattering switch (debounced) */
+            traceKey(KEY_Z, 1, TRACE_REPORT_GAP);
+            traceKey(KEY_Z, 0, TRACE_CHATTER_GAP);
+            traceKey(KEY_Z, 1, TRACE_CHATTER_GAP);
+            traceKey(KEY_Z, 0, TRACE_REPORT_GAP);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}